@@ -4,6 +4,11 @@
 #include <errno.h>
 #include <chrono>
 #include <thread>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <deque>
+#include <functional>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -22,9 +27,7 @@
 #define WIDTH 860
 #define HEIGHT 640
 
-#define MAX_TRIANGLES 1000
-#define MAX_VERTEX_COUNT MAX_TRIANGLES * 3
-#define MAX_IDX_COUNT MAX_TRIANGLES * 3
+#define CUBE_VERTEX_COUNT 36 // the cube is all the demo draws
 
 const static char *vertex_shader_source = R"(
   #version 330 core
@@ -161,20 +164,198 @@ typedef struct {
 } Cube;
 
 
-uint32_t put_vertice(uint32_t idx, Vertex vertices[MAX_VERTEX_COUNT], Position pos, Color color) {
+uint32_t put_vertice(uint32_t idx, Vertex *vertices, Position pos, Color color) {
   vertices[idx].position = pos;
   vertices[idx].color = color;
   //vertices[idx].size = 10.0f;
   return idx;
 }
 
+// the 36 vertices of a unit cube, returns the next free idx
+uint32_t put_cube(uint32_t idx, Vertex *vertices) {
+  float verts[] = {
+    -0.5f, -0.5f, -0.5f,
+    0.5f, -0.5f, -0.5f, 
+    0.5f,  0.5f, -0.5f, 
+    0.5f,  0.5f, -0.5f, 
+    -0.5f,  0.5f, -0.5f,
+    -0.5f, -0.5f, -0.5f,
+
+    -0.5f, -0.5f,  0.5f,
+    0.5f, -0.5f,  0.5f, 
+    0.5f,  0.5f,  0.5f,  
+    0.5f,  0.5f,  0.5f,  
+    -0.5f,  0.5f,  0.5f, 
+    -0.5f, -0.5f,  0.5f, 
+
+    -0.5f,  0.5f,  0.5f,
+    -0.5f,  0.5f, -0.5f,
+    -0.5f, -0.5f, -0.5f, 
+    -0.5f, -0.5f, -0.5f,  
+    -0.5f, -0.5f,  0.5f,  
+    -0.5f,  0.5f,  0.5f,  
+
+    0.5f,  0.5f,  0.5f,
+    0.5f,  0.5f, -0.5f,
+    0.5f, -0.5f, -0.5f,
+    0.5f, -0.5f, -0.5f,
+    0.5f, -0.5f,  0.5f,
+    0.5f,  0.5f,  0.5f,
+
+    -0.5f, -0.5f, -0.5f,
+    0.5f, -0.5f, -0.5f,
+    0.5f, -0.5f,  0.5f,
+    0.5f, -0.5f,  0.5f,
+    -0.5f, -0.5f,  0.5f,
+    -0.5f, -0.5f, -0.5f,
+
+    -0.5f,  0.5f, -0.5f, 
+    0.5f,  0.5f, -0.5f, 
+    0.5f,  0.5f,  0.5f, 
+    0.5f,  0.5f,  0.5f, 
+    -0.5f,  0.5f,  0.5f, 
+    -0.5f,  0.5f, -0.5f
+  };
+
+  for (uint32_t i = 0; i < (sizeof(verts)/sizeof(verts[0]))-2; i += 3) {
+    put_vertice(
+      idx,
+      vertices,
+      (Position){
+	.x = verts[i],
+	.y = verts[i+1],
+	.z = verts[i+2],
+	.w = 1.0f,
+      },
+      (Color){
+	.r = 1.0f,
+	.g = 0.5f,
+	.b = 1.0f,
+	.a = 1.0f,
+      }
+    );
+    idx++;
+  }
+  return idx;
+}
+
 // mouse offset 1 -1
 glm::vec3 mouse_to_gl_point(float x, float y) {
   return glm::vec3((2.0f * x) / WIDTH - 1.0f, 1.0f - (2.0f * y) / HEIGHT, 0.0f);
 }
 
-void draw(uint32_t VAO, uint32_t program, uint32_t idx, Vertex *vertices, Cube cube) {
-  float time = (float)glfwGetTime();
+// Clip stage: triangles are taken to clip space on the cpu and clipped
+// against the six frustum planes before upload, so geometry out of the
+// frustum never reaches the vertex buffer. x and y are tested against a
+// guard band of GUARD_BAND * w, triangles that only stick out of the
+// viewport sideways are kept whole and left to the rasterizer (1.0 would
+// clip exactly to the viewport), near and far always clip. Attributes are
+// interpolated in clip space so the GPU still interpolates them perspective
+// correct.
+
+#define GUARD_BAND 2.0f
+#define CLIP_PLANES 6
+#define CLIP_MAX_POLY 9 // a triangle clipped by 6 planes
+#define CLIP_MAX_VERTICES(count) ((count) * (CLIP_MAX_POLY - 2)) // fanned back into triangles
+
+enum ClipPlane { CLIP_LEFT, CLIP_RIGHT, CLIP_BOTTOM, CLIP_TOP, CLIP_NEAR, CLIP_FAR };
+
+glm::vec4 to_vec4(Position p) {
+  return glm::vec4(p.x, p.y, p.z, p.w);
+}
+
+Position to_position(glm::vec4 p) {
+  return (Position){ .x = p.x, .y = p.y, .z = p.z, .w = p.w };
+}
+
+Vertex lerp_vertex(Vertex a, Vertex b, float t) {
+  glm::vec4 pos = glm::mix(to_vec4(a.position), to_vec4(b.position), t);
+  return (Vertex){
+    .position = to_position(pos),
+    .color = (Color){
+      .r = a.color.r + (b.color.r - a.color.r) * t,
+      .g = a.color.g + (b.color.g - a.color.g) * t,
+      .b = a.color.b + (b.color.b - a.color.b) * t,
+      .a = a.color.a + (b.color.a - a.color.a) * t,
+    },
+  };
+}
+
+// signed distance to the plane, inside when >= 0
+float plane_distance(glm::vec4 p, ClipPlane plane) {
+  switch (plane) {
+  case CLIP_LEFT:   return p.x + GUARD_BAND * p.w;
+  case CLIP_RIGHT:  return GUARD_BAND * p.w - p.x;
+  case CLIP_BOTTOM: return p.y + GUARD_BAND * p.w;
+  case CLIP_TOP:    return GUARD_BAND * p.w - p.y;
+  case CLIP_NEAR:   return p.z + p.w;
+  case CLIP_FAR:    return p.w - p.z;
+  default:          return 0.0f;
+  }
+}
+
+// bit i set when p is outside plane i
+uint32_t outcode(glm::vec4 p) {
+  uint32_t code = 0;
+  for (uint32_t i = 0; i < CLIP_PLANES; i++) {
+    if (plane_distance(p, (ClipPlane)i) < 0.0f) code |= 1u << i;
+  }
+  return code;
+}
+
+uint32_t clip_edge(const Vertex *in, uint32_t n, Vertex *out, ClipPlane plane) {
+  uint32_t count = 0;
+  Vertex v1 = in[n - 1];
+  float d1 = plane_distance(to_vec4(v1.position), plane);
+  for (uint32_t i = 0; i < n; i++) {
+    Vertex v2 = in[i];
+    float d2 = plane_distance(to_vec4(v2.position), plane);
+    if ((d1 >= 0.0f) != (d2 >= 0.0f)) out[count++] = lerp_vertex(v1, v2, d1 / (d1 - d2));
+    if (d2 >= 0.0f) out[count++] = v2;
+    v1 = v2;
+    d1 = d2;
+  }
+  return count;
+}
+
+// transforms a triangle list by mvp, clips it and writes the surviving
+// triangles to out, which holds CLIP_MAX_VERTICES(count). returns how many
+// vertices were written
+uint32_t clip_triangles(const Vertex *in, uint32_t count, glm::mat4 mvp, Vertex *out) {
+  uint32_t n_out = 0;
+  for (uint32_t i = 0; i + 2 < count; i += 3) {
+    Vertex a[CLIP_MAX_POLY], b[CLIP_MAX_POLY];
+    uint32_t codes[3];
+    for (uint32_t k = 0; k < 3; k++) {
+      a[k] = in[i + k];
+      a[k].position = to_position(mvp * to_vec4(in[i + k].position));
+      codes[k] = outcode(to_vec4(a[k].position));
+    }
+    if (codes[0] & codes[1] & codes[2]) continue; // all outside the same plane
+
+    Vertex *poly = a;
+    uint32_t n = 3;
+    uint32_t crossed = codes[0] | codes[1] | codes[2];
+    if (crossed) {
+      Vertex *dst = b;
+      for (uint32_t p = 0; p < CLIP_PLANES && n > 0; p++) {
+        if (!(crossed & (1u << p))) continue;
+        n = clip_edge(poly, n, dst, (ClipPlane)p);
+        std::swap(poly, dst);
+      }
+    }
+
+    for (uint32_t k = 1; k + 1 < n; k++) {
+      out[n_out++] = poly[0];
+      out[n_out++] = poly[k];
+      out[n_out++] = poly[k + 1];
+    }
+  }
+  return n_out;
+}
+
+// projection * view * model of the cube at time
+glm::mat4 cube_mvp(Cube cube, float time, float aspect) {
   glm::mat4 view = glm::mat4(1.0f);
   view = glm::lookAt(glm::vec3(0.0f, cube.translate.y * time, 3.0f), 
   		   glm::vec3(0.0f, 0.0f, 0.0f), 
@@ -187,22 +368,280 @@ void draw(uint32_t VAO, uint32_t program, uint32_t idx, Vertex *vertices, Cube c
   model = glm::rotate(model, glm::radians(cube.angle), cube.axis);
   model = glm::translate(model, cube.translate);
 
-  projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, 10.0f);
+  projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 10.0f);
+  return projection * view * model;
+}
+
+void draw(uint32_t VAO, uint32_t VBO, uint32_t program, uint32_t idx, Vertex *vertices, Vertex *clipped, Cube cube) {
+  float time = (float)glfwGetTime();
 
   int v_model = glGetUniformLocation(program, "v_model");
   int v_view = glGetUniformLocation(program, "v_view");
   int v_projection = glGetUniformLocation(program, "v_projection");
   int v_time = glGetUniformLocation(program, "v_time");
-  glUniformMatrix4fv(v_model, 1, GL_FALSE, &model[0][0]);
-  glUniformMatrix4fv(v_view, 1, GL_FALSE, &view[0][0]);
-  glUniformMatrix4fv(v_projection, 1, GL_FALSE, &projection[0][0]);
+  // vertices are uploaded already in clip space
+  uint32_t count = clip_triangles(vertices, idx, cube_mvp(cube, time, (float)WIDTH / (float)HEIGHT), clipped);
+  glm::mat4 identity = glm::mat4(1.0f);
+
+  glUniformMatrix4fv(v_model, 1, GL_FALSE, &identity[0][0]);
+  glUniformMatrix4fv(v_view, 1, GL_FALSE, &identity[0][0]);
+  glUniformMatrix4fv(v_projection, 1, GL_FALSE, &identity[0][0]);
   glUniform1f(v_time, time);
 
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Vertex), clipped);
   glBindVertexArray(VAO);
-  glDrawArrays(GL_TRIANGLES, 0, idx);
+  glDrawArrays(GL_TRIANGLES, 0, count);
   //glDrawElements(GL_TRIANGLES, idx, GL_UNSIGNED_INT, 0);
 }
 
+// Software rasterizer for hosts without a GL context. The clip_triangles
+// output is divided by w, mapped to the viewport and binned into screen
+// tiles, tiles are rasterized in parallel with half-space edge functions,
+// a depth test and perspective correct colors, shaded like the fragment
+// shader and written as PPM.
+
+#define TILE_SIZE 64
+
+typedef struct {
+  uint32_t width, height;
+  std::vector<uint8_t> pixels; // rgb
+  std::vector<float> depth;
+} Framebuffer;
+
+typedef struct {
+  glm::vec2 p[3]; // window coordinates, y down
+  float z[3];     // depth in [0, 1]
+  float inv_w[3];
+  Color color[3]; // divided by w
+  float inv_area;
+  int32_t min_x, min_y, max_x, max_y;
+} RasterTriangle;
+
+typedef struct {
+  std::mutex lock;
+  std::deque<uint32_t> items;
+} WorkQueue;
+
+bool work_queue_pop(std::vector<WorkQueue> *queues, uint32_t id, uint32_t *item) {
+  {
+    WorkQueue *own = &(*queues)[id];
+    std::lock_guard<std::mutex> guard(own->lock);
+    if (!own->items.empty()) {
+      *item = own->items.back();
+      own->items.pop_back();
+      return true;
+    }
+  }
+  // own queue is empty, steal from the front of the others
+  for (uint32_t i = 1; i < queues->size(); i++) {
+    WorkQueue *victim = &(*queues)[(id + i) % queues->size()];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (!victim->items.empty()) {
+      *item = victim->items.front();
+      victim->items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+// runs fn(item) for item in [0, count) on a work-stealing pool
+void parallel_for(uint32_t count, uint32_t threads, const std::function<void(uint32_t)> &fn) {
+  if (threads == 0) threads = 1;
+  std::vector<WorkQueue> queues(threads);
+  for (uint32_t i = 0; i < count; i++) {
+    queues[i * threads / count].items.push_back(i);
+  }
+
+  std::vector<std::thread> workers;
+  for (uint32_t id = 0; id < threads; id++) {
+    workers.emplace_back([&queues, &fn, id]() {
+      uint32_t item;
+      while (work_queue_pop(&queues, id, &item)) fn(item);
+    });
+  }
+  for (auto &w : workers) w.join();
+}
+
+float edge_function(glm::vec2 a, glm::vec2 b, glm::vec2 p) {
+  return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// clip space triangle list to screen triangles, degenerate ones are dropped
+void raster_setup(const Vertex *clipped, uint32_t count, uint32_t width, uint32_t height, std::vector<RasterTriangle> *out) {
+  out->clear();
+  for (uint32_t i = 0; i + 2 < count; i += 3) {
+    RasterTriangle t;
+    for (uint32_t k = 0; k < 3; k++) {
+      Position p = clipped[i + k].position;
+      Color c = clipped[i + k].color;
+      float inv_w = 1.0f / p.w;
+      t.p[k] = glm::vec2((p.x * inv_w + 1.0f) * 0.5f * width, (1.0f - p.y * inv_w) * 0.5f * height);
+      t.z[k] = p.z * inv_w * 0.5f + 0.5f;
+      t.inv_w[k] = inv_w;
+      t.color[k] = (Color){ .r = c.r * inv_w, .g = c.g * inv_w, .b = c.b * inv_w, .a = c.a * inv_w };
+    }
+    float area = edge_function(t.p[0], t.p[1], t.p[2]);
+    if (area == 0.0f) continue;
+    t.inv_area = 1.0f / area;
+    t.min_x = std::max(0, (int32_t)floorf(std::min(t.p[0].x, std::min(t.p[1].x, t.p[2].x))));
+    t.min_y = std::max(0, (int32_t)floorf(std::min(t.p[0].y, std::min(t.p[1].y, t.p[2].y))));
+    t.max_x = std::min((int32_t)width - 1, (int32_t)ceilf(std::max(t.p[0].x, std::max(t.p[1].x, t.p[2].x))));
+    t.max_y = std::min((int32_t)height - 1, (int32_t)ceilf(std::max(t.p[0].y, std::max(t.p[1].y, t.p[2].y))));
+    if (t.min_x > t.max_x || t.min_y > t.max_y) continue;
+    out->push_back(t);
+  }
+}
+
+// fragment shader on the cpu
+Color shade(Color c, float time) {
+  float k = sinf(time) / cosf(time);
+  return (Color){ .r = c.r * k * sinf(time), .g = c.g * k, .b = c.b * k * cosf(time), .a = 1.0f };
+}
+
+void raster_tile(Framebuffer *fb, const RasterTriangle *triangles, const std::vector<uint32_t> &bin, uint32_t tile, float time) {
+  uint32_t tiles_x = (fb->width + TILE_SIZE - 1) / TILE_SIZE;
+  int32_t x0 = (tile % tiles_x) * TILE_SIZE;
+  int32_t y0 = (tile / tiles_x) * TILE_SIZE;
+  int32_t x1 = std::min(x0 + TILE_SIZE, (int32_t)fb->width) - 1;
+  int32_t y1 = std::min(y0 + TILE_SIZE, (int32_t)fb->height) - 1;
+
+  for (uint32_t i : bin) {
+    const RasterTriangle *t = &triangles[i];
+    int32_t min_x = std::max(x0, t->min_x), max_x = std::min(x1, t->max_x);
+    int32_t min_y = std::max(y0, t->min_y), max_y = std::min(y1, t->max_y);
+
+    // edge functions at the first pixel center, stepped by their x/y slopes.
+    // scaled by 1 / area they are the barycentrics and positive inside for
+    // either winding
+    glm::vec2 start = glm::vec2(min_x + 0.5f, min_y + 0.5f);
+    float e0 = edge_function(t->p[1], t->p[2], start) * t->inv_area;
+    float e1 = edge_function(t->p[2], t->p[0], start) * t->inv_area;
+    float e2 = edge_function(t->p[0], t->p[1], start) * t->inv_area;
+    float dx0 = (t->p[1].y - t->p[2].y) * t->inv_area, dy0 = (t->p[2].x - t->p[1].x) * t->inv_area;
+    float dx1 = (t->p[2].y - t->p[0].y) * t->inv_area, dy1 = (t->p[0].x - t->p[2].x) * t->inv_area;
+    float dx2 = (t->p[0].y - t->p[1].y) * t->inv_area, dy2 = (t->p[1].x - t->p[0].x) * t->inv_area;
+
+    for (int32_t y = min_y; y <= max_y; y++) {
+      float w0 = e0, w1 = e1, w2 = e2;
+      for (int32_t x = min_x; x <= max_x; x++) {
+        if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f) {
+          uint32_t px = y * fb->width + x;
+          float z = w0 * t->z[0] + w1 * t->z[1] + w2 * t->z[2];
+          if (z < fb->depth[px]) {
+            fb->depth[px] = z;
+            float w = 1.0f / (w0 * t->inv_w[0] + w1 * t->inv_w[1] + w2 * t->inv_w[2]);
+            Color c = shade((Color){
+              .r = (w0 * t->color[0].r + w1 * t->color[1].r + w2 * t->color[2].r) * w,
+              .g = (w0 * t->color[0].g + w1 * t->color[1].g + w2 * t->color[2].g) * w,
+              .b = (w0 * t->color[0].b + w1 * t->color[1].b + w2 * t->color[2].b) * w,
+              .a = 1.0f,
+            }, time);
+            uint8_t *rgb = &fb->pixels[px * 3];
+            rgb[0] = (uint8_t)(glm::clamp(c.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+            rgb[1] = (uint8_t)(glm::clamp(c.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+            rgb[2] = (uint8_t)(glm::clamp(c.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+          }
+        }
+        w0 += dx0;
+        w1 += dx1;
+        w2 += dx2;
+      }
+      e0 += dy0;
+      e1 += dy1;
+      e2 += dy2;
+    }
+  }
+}
+
+void raster_frame(Framebuffer *fb, const std::vector<RasterTriangle> &triangles, std::vector<std::vector<uint32_t>> *bins, uint32_t threads, float time) {
+  uint32_t tiles_x = (fb->width + TILE_SIZE - 1) / TILE_SIZE;
+  uint32_t tiles_y = (fb->height + TILE_SIZE - 1) / TILE_SIZE;
+  bins->resize(tiles_x * tiles_y);
+  for (auto &bin : *bins) bin.clear();
+  for (uint32_t i = 0; i < triangles.size(); i++) {
+    const RasterTriangle *t = &triangles[i];
+    for (int32_t ty = t->min_y / TILE_SIZE; ty <= t->max_y / TILE_SIZE; ty++) {
+      for (int32_t tx = t->min_x / TILE_SIZE; tx <= t->max_x / TILE_SIZE; tx++) {
+        (*bins)[ty * tiles_x + tx].push_back(i);
+      }
+    }
+  }
+
+  parallel_for(tiles_x * tiles_y, threads, [&](uint32_t tile) {
+    uint32_t x0 = (tile % tiles_x) * TILE_SIZE, y0 = (tile / tiles_x) * TILE_SIZE;
+    for (uint32_t y = y0; y < std::min(y0 + TILE_SIZE, fb->height); y++) {
+      for (uint32_t x = x0; x < std::min(x0 + TILE_SIZE, fb->width); x++) {
+        fb->depth[y * fb->width + x] = 1.0f;
+        memset(&fb->pixels[(y * fb->width + x) * 3], 0, 3);
+      }
+    }
+    raster_tile(fb, triangles.data(), (*bins)[tile], tile, time);
+  });
+}
+
+int write_ppm(const char *path, const uint8_t *pixels, uint32_t width, uint32_t height) {
+  FILE *f = fopen(path, "wb");
+  if (f == nullptr) {
+    std::cerr << "Could not open " << path << std::endl;
+    std::cerr << "error: " << strerror(errno) << std::endl;
+    return -1;
+  }
+  fprintf(f, "P6\n%u %u\n255\n", width, height);
+  fwrite(pixels, 1, width * height * 3, f);
+  fclose(f);
+  return 0;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// renders frames of the spinning cube scene, cubes of them in a grid, and
+// writes the last frame to path
+int render(const char *path, uint32_t width, uint32_t height, uint32_t threads, uint32_t cubes) {
+  std::vector<Vertex> vertices(CUBE_VERTEX_COUNT);
+  put_cube(0, vertices.data());
+  std::vector<Vertex> clipped(CLIP_MAX_VERTICES(vertices.size())), scene;
+  std::vector<RasterTriangle> triangles;
+  std::vector<std::vector<uint32_t>> bins;
+  Framebuffer fb = { .width = width, .height = height, .pixels = std::vector<uint8_t>(width * height * 3), .depth = std::vector<float>(width * height) };
+
+  uint32_t side = (uint32_t)ceilf(sqrtf((float)cubes));
+  const uint32_t frames = 30;
+  double setup_ms = 0.0, raster_ms = 0.0;
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    float time = 0.2f + frame / 30.0f;
+    auto start = std::chrono::steady_clock::now();
+    scene.clear();
+    for (uint32_t i = 0; i < cubes; i++) {
+      Cube cube = {
+        .translate = glm::vec3(0.0f),
+        .scale = glm::vec3(1.0f / side),
+        .angle = 1.0f + frame * 5.0f + i * 7.0f,
+        .axis = glm::vec3(1.0f, 1.0f, 1.0f),
+      };
+      if (cubes > 1) cube.translate = glm::vec3((i % side) * 2.0f - (side - 1.0f), (i / side) * 2.0f - (side - 1.0f), 0.0f) * 1.2f;
+      uint32_t count = clip_triangles(vertices.data(), vertices.size(), cube_mvp(cube, time, (float)width / (float)height), clipped.data());
+      scene.insert(scene.end(), clipped.begin(), clipped.begin() + count);
+    }
+    raster_setup(scene.data(), scene.size(), width, height, &triangles);
+    setup_ms += elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    raster_frame(&fb, triangles, &bins, threads, time);
+    raster_ms += elapsed_ms(start);
+  }
+
+  uint32_t covered = 0;
+  for (float z : fb.depth) covered += z < 1.0f;
+  std::cout << "rendered " << frames << " frames of " << width << "x" << height << ", " << triangles.size() << " triangles, " << threads << " threads" << std::endl;
+  std::cout << "setup " << setup_ms / frames << " ms, raster " << raster_ms / frames << " ms per frame (" << 1000.0 * frames / (setup_ms + raster_ms) << " fps)" << std::endl;
+  std::cout << "covered pixels: " << covered << std::endl;
+  return write_ppm(path, fb.pixels.data(), width, height);
+}
+
 void loop(GLFWwindow *window) {
 
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -249,72 +688,11 @@ void loop(GLFWwindow *window) {
   int error = compile_shaders(&program);
   if (error != 0) exit(1);
   
-  Vertex vertices[MAX_VERTEX_COUNT];
+  Vertex vertices[CUBE_VERTEX_COUNT];
+  Vertex clipped[CLIP_MAX_VERTICES(CUBE_VERTEX_COUNT)];
   uint32_t idx = 0;
 
-  float verts[] = {
-    -0.5f, -0.5f, -0.5f,
-    0.5f, -0.5f, -0.5f, 
-    0.5f,  0.5f, -0.5f, 
-    0.5f,  0.5f, -0.5f, 
-    -0.5f,  0.5f, -0.5f,
-    -0.5f, -0.5f, -0.5f,
-
-    -0.5f, -0.5f,  0.5f,
-    0.5f, -0.5f,  0.5f, 
-    0.5f,  0.5f,  0.5f,  
-    0.5f,  0.5f,  0.5f,  
-    -0.5f,  0.5f,  0.5f, 
-    -0.5f, -0.5f,  0.5f, 
-
-    -0.5f,  0.5f,  0.5f,
-    -0.5f,  0.5f, -0.5f,
-    -0.5f, -0.5f, -0.5f, 
-    -0.5f, -0.5f, -0.5f,  
-    -0.5f, -0.5f,  0.5f,  
-    -0.5f,  0.5f,  0.5f,  
-
-    0.5f,  0.5f,  0.5f,
-    0.5f,  0.5f, -0.5f,
-    0.5f, -0.5f, -0.5f,
-    0.5f, -0.5f, -0.5f,
-    0.5f, -0.5f,  0.5f,
-    0.5f,  0.5f,  0.5f,
-
-    -0.5f, -0.5f, -0.5f,
-    0.5f, -0.5f, -0.5f,
-    0.5f, -0.5f,  0.5f,
-    0.5f, -0.5f,  0.5f,
-    -0.5f, -0.5f,  0.5f,
-    -0.5f, -0.5f, -0.5f,
-
-    -0.5f,  0.5f, -0.5f, 
-    0.5f,  0.5f, -0.5f, 
-    0.5f,  0.5f,  0.5f, 
-    0.5f,  0.5f,  0.5f, 
-    -0.5f,  0.5f,  0.5f, 
-    -0.5f,  0.5f, -0.5f
-  };
-
-  for (uint32_t i = 0; i < (sizeof(verts)/sizeof(verts[0]))-2; i += 3) {
-    put_vertice(
-      idx,
-      vertices,
-      (Position){
-	.x = verts[i],
-	.y = verts[i+1],
-	.z = verts[i+2],
-	.w = 1.0f,
-      },
-      (Color){
-	.r = 1.0f,
-	.g = 0.5f,
-	.b = 1.0f,
-	.a = 1.0f,
-      }
-    );
-    idx++;
-  }
+  idx = put_cube(idx, vertices);
   // put_vertice(idx, vertices, (Position){ .x = 0.2f, .y = 0.2, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f });
   // idx++;
   // put_vertice(idx, vertices, (Position){ .x = 0.2f, .y = -0.2, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f });
@@ -335,7 +713,7 @@ void loop(GLFWwindow *window) {
   glBindVertexArray(VAO);
   
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(clipped), nullptr, GL_DYNAMIC_DRAW);
   
   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
   glEnableVertexAttribArray(0); // location 0
@@ -461,7 +839,7 @@ void loop(GLFWwindow *window) {
     glUseProgram(program);
 
     //glBindVertexArray(VAO);
-    draw(VAO, program, idx, vertices, cube);
+    draw(VAO, VBO, program, idx, vertices, clipped, cube);
 
     
     // std::cout << "total clicks: " << total_click << std::endl;
@@ -474,9 +852,17 @@ void loop(GLFWwindow *window) {
   glfwDestroyCursor(cursor);
 }
 
-int main(void) {
+int main(int argc, char **argv) {
   std::cout << "hello, world!" << std::endl;
 
+  if (argc > 2 && strcmp(argv[1], "render") == 0) {
+    uint32_t width = argc > 3 ? atoi(argv[3]) : 1280;
+    uint32_t height = argc > 4 ? atoi(argv[4]) : 900;
+    uint32_t threads = argc > 5 ? atoi(argv[5]) : std::thread::hardware_concurrency();
+    uint32_t cubes = argc > 6 ? atoi(argv[6]) : 1;
+    return render(argv[2], width, height, threads, cubes) == 0 ? 0 : 1;
+  }
+
   if (!glfwInit()) {
     std::cerr << "Could not initialize glfw!" << std::endl;
     std::cerr << "error: " << strerror(errno) << std::endl;
@@ -4,6 +4,8 @@
 #include <errno.h>
 #include <chrono>
 #include <thread>
+#include <vector>
+#include <algorithm>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -22,11 +24,6 @@
 #define WIDTH 860
 #define HEIGHT 640
 
-// P O Q e a origem, vetor u e v
-#define MAX_LINES 2
-#define MAX_VERTEX_COUNT MAX_LINES * 2 + 1 + 3
-#define MAX_IDX_COUNT MAX_LINES * 2 + 1 + 3
-
 const static char *vertex_shader_source = "#version 330 core\n"
   "layout (location = 0) in vec4 v_pos;\n"
   "layout (location = 1) in vec4 v_color;\n"
@@ -142,10 +139,95 @@ typedef struct {
   uint32_t idxs[2]; // line vertexs
 } Line;
 
-uint32_t put_vertice(uint32_t idx, Vertex vertices[MAX_VERTEX_COUNT], Position pos, Color color) {
-  vertices[idx].position = pos;
-  vertices[idx].color = color;
-  vertices[idx].size = 10.0f;
+// Vertex store of sistemas_graficos/main.cpp, with the size attribute.
+#define VERTEX_CHUNK 3072 // vertices, the VBO holds whole chunks
+
+typedef struct {
+  std::vector<Vertex> vertices;
+  uint32_t dirty_min, dirty_max; // [dirty_min, dirty_max), empty when min >= max
+  uint32_t VAO, VBO;
+  uint32_t capacity;     // vertices the VBO holds
+  uint32_t frame_bytes;  // uploaded by the last flush
+  uint64_t total_bytes;
+  uint32_t grows;
+} VertexStore;
+
+// for the VBO bound to GL_ARRAY_BUFFER
+void vertex_attributes() {
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+  glEnableVertexAttribArray(0); // location 0
+
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+  glEnableVertexAttribArray(1); // location 1
+
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, size));
+  glEnableVertexAttribArray(2); // location 2
+}
+
+void store_init(VertexStore *s, uint32_t VAO) {
+  s->vertices.clear();
+  s->dirty_min = UINT32_MAX;
+  s->dirty_max = 0;
+  s->VAO = VAO;
+  s->capacity = VERTEX_CHUNK;
+  s->frame_bytes = 0;
+  s->total_bytes = 0;
+  s->grows = 0;
+  glGenBuffers(1, &s->VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)s->capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+  glBindVertexArray(VAO);
+  vertex_attributes();
+}
+
+Vertex *store_write(VertexStore *s, uint32_t idx) {
+  if (idx >= s->vertices.size()) s->vertices.resize(idx + 1);
+  s->dirty_min = std::min(s->dirty_min, idx);
+  s->dirty_max = std::max(s->dirty_max, idx + 1);
+  return &s->vertices[idx];
+}
+
+void store_grow(VertexStore *s, uint32_t count) {
+  uint32_t capacity = std::max(2 * s->capacity, (count + VERTEX_CHUNK - 1) / VERTEX_CHUNK * VERTEX_CHUNK);
+  uint32_t VBO;
+  glGenBuffers(1, &VBO);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+  glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, s->VBO);
+  uint32_t end = std::min(s->dirty_min, s->capacity);
+  if (end > 0) glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)end * sizeof(Vertex));
+  if (s->dirty_max < s->capacity) {
+    GLintptr offset = (GLintptr)s->dirty_max * sizeof(Vertex);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, offset, (GLsizeiptr)s->capacity * sizeof(Vertex) - offset);
+  }
+  glDeleteBuffers(1, &s->VBO);
+  s->VBO = VBO;
+  s->capacity = capacity;
+  s->grows++;
+  glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+  glBindVertexArray(s->VAO);
+  vertex_attributes();
+}
+
+uint32_t store_flush(VertexStore *s) {
+  s->frame_bytes = 0;
+  if (s->dirty_min < s->dirty_max) {
+    if (s->vertices.size() > s->capacity) store_grow(s, s->vertices.size());
+    s->frame_bytes = (s->dirty_max - s->dirty_min) * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)s->dirty_min * sizeof(Vertex), s->frame_bytes, &s->vertices[s->dirty_min]);
+    s->total_bytes += s->frame_bytes;
+    s->dirty_min = UINT32_MAX;
+    s->dirty_max = 0;
+  }
+  return s->frame_bytes;
+}
+
+uint32_t put_vertice(uint32_t idx, VertexStore *store, Position pos, Color color) {
+  Vertex *v = store_write(store, idx);
+  v->position = pos;
+  v->color = color;
+  v->size = 10.0f;
   return idx;
 }
 
@@ -154,14 +236,14 @@ glm::vec3 mouse_to_gl_point(float x, float y) {
   return glm::vec3((2.0f * x) / WIDTH - 1.0f, 1.0f - (2.0f * y) / HEIGHT, 0.0f);
 }
 
-void draw(uint32_t VAO, uint32_t program, uint32_t idx, Vertex *vertices, uint32_t lidx, Line lines[MAX_LINES]) {
+void draw(uint32_t VAO, uint32_t program, const std::vector<Line> &lines) {
   glBindVertexArray(VAO);
   
   glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
   uint32_t v_model = glGetUniformLocation(program, "v_transform");
   glUniformMatrix4fv(v_model, 1, GL_FALSE, &model[0][0]);
 
-  for (uint32_t i = 0; i < lidx; i++) {
+  for (uint32_t i = 0; i < lines.size(); i++) {
     Line line = lines[i];
     glDrawArrays(GL_LINES, line.idxs[0], 2);
   }
@@ -214,33 +296,18 @@ void loop(GLFWwindow *window) {
   int error = compile_shaders(&program);
   if (error != 0) exit(1);
   
-  Line lines[MAX_LINES];
-  uint32_t lidx = 0;
-
-  Vertex vertices[MAX_VERTEX_COUNT];
-  uint32_t idx = 0;
-
-  put_vertice(idx, vertices, (Position){ .x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
-  idx++; // put origin
+  std::vector<Line> lines; // vetor u e v
 
-  uint32_t VAO, VBO;
+  uint32_t VAO;
 
   glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
-
-  glBindVertexArray(VAO);
-  
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-  glEnableVertexAttribArray(0); // location 0
 
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
-  glEnableVertexAttribArray(1); // location 1
+  VertexStore store;
+  store_init(&store, VAO);
+  uint32_t idx = 0;
 
-  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, size));
-  glEnableVertexAttribArray(2); // location 2
+  put_vertice(idx, &store, (Position){ .x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
+  idx++; // put origin
 
   glBindBuffer(GL_ARRAY_BUFFER, 0); 
 
@@ -287,19 +354,16 @@ void loop(GLFWwindow *window) {
 
 	  switch (total_click) {
 	  case 0: {
-	    put_vertice(idx, vertices, (Position){ .x = point.x, .y = point.y, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f });
+	    put_vertice(idx, &store, (Position){ .x = point.x, .y = point.y, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f });
 	  } break;
 	  case 1: {
-	    put_vertice(idx, vertices, (Position){ .x = point.x, .y = point.y, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f });
+	    put_vertice(idx, &store, (Position){ .x = point.x, .y = point.y, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f });
 	  } break;
 	  case 2: {
-	    put_vertice(idx, vertices, (Position){ .x = point.x, .y = point.y, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f });
+	    put_vertice(idx, &store, (Position){ .x = point.x, .y = point.y, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f });
 	  } break;
 	  }
 	  idx++;
-
-	  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
 	}
 
 	total_click++;
@@ -317,9 +381,9 @@ void loop(GLFWwindow *window) {
 
     if (idx == 4) {
       // pula a origem
-      Vertex P = vertices[1];
-      Vertex O = vertices[2];
-      Vertex Q = vertices[3];
+      Vertex P = store.vertices[1];
+      Vertex O = store.vertices[2];
+      Vertex Q = store.vertices[3];
 
       glm::vec3 p_pos = glm::vec3(P.position.x, P.position.y, 0.0f);
       glm::vec3 o_pos = glm::vec3(O.position.x, O.position.y, 0.0f);
@@ -348,15 +412,14 @@ void loop(GLFWwindow *window) {
 	}
       };
 
-      uint32_t u_origem = put_vertice(idx, vertices, (Position){ .x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
+      uint32_t u_origem = put_vertice(idx, &store, (Position){ .x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
       idx++; // put origin
-      uint32_t u1 = put_vertice(idx, vertices, u.position, u.color);
+      uint32_t u1 = put_vertice(idx, &store, u.position, u.color);
       idx++; // vertice
 
-      lines[lidx] = (Line){
+      lines.push_back((Line){
       	.idxs = { u_origem, u1 }
-      };
-      lidx++;
+      });
       
       glm::vec3 v_coord = q_pos - o_pos;
       std::cout << "vector v: " << glm::to_string(v_coord) << std::endl;
@@ -376,15 +439,14 @@ void loop(GLFWwindow *window) {
 	}
       };
 
-      uint32_t v_origem = put_vertice(idx, vertices, (Position){ .x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
+      uint32_t v_origem = put_vertice(idx, &store, (Position){ .x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
       idx++; // put origin
-      uint32_t v1 = put_vertice(idx, vertices, v.position, v.color);
+      uint32_t v1 = put_vertice(idx, &store, v.position, v.color);
       idx++; // vertice
       
-      lines[lidx] = (Line){
+      lines.push_back((Line){
       	.idxs = { v_origem, v1 }
-      };
-      lidx++;
+      });
       
 
       // contas com os valores da screen
@@ -420,10 +482,10 @@ void loop(GLFWwindow *window) {
       
       //std::cout << "glm u x v: " << glm::to_string(glm_prod_vetorial) << std::endl;
       std::cout << "distancia do ponto P de v: " << glm::length(prod_v_qo) / glm::length(v_coord) << std::endl;
+    }
 
-      // marca que 4 pontos foram adicionados para o opengl
-      glBindBuffer(GL_ARRAY_BUFFER, VBO);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+    if (store_flush(&store) > 0) {
+      std::cout << "bytes uploaded: " << store.frame_bytes << " (total " << store.total_bytes << ")" << std::endl;
     }
     
 
@@ -432,13 +494,13 @@ void loop(GLFWwindow *window) {
     glUseProgram(program);
 
     //glBindVertexArray(VAO);
-    draw(VAO, program, idx, vertices, lidx, lines);
+    draw(VAO, program, lines);
     glDrawArrays(GL_POINTS, 0, idx);
 
     
     // std::cout << "total clicks: " << total_click << std::endl;
     //std::cout << "total vertices: " << idx << std::endl;
-    // std::cout << "total lines: " << lidx << std::endl;
+    // std::cout << "total lines: " << lines.size() << std::endl;
     
     glfwSwapBuffers(window);
     glfwPollEvents();
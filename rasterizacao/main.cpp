@@ -6,6 +6,17 @@
 #include <chrono>
 #include <thread>
 #include <vector>
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
@@ -23,21 +34,22 @@
 #define WIDTH 1280
 #define HEIGHT 900
 
-#define MAX_TRIANGLES 1000
-#define MAX_VERTEX_COUNT MAX_TRIANGLES * 3
-#define MAX_IDX_COUNT MAX_TRIANGLES * 3
+// pixel stream capacity, reserved once
+#define MAX_PIXELS (1 << 16)
 
 const static char *vertex_shader_source = R"(
   #version 330 core
-  layout (location = 0) in vec4 v_pos;
-  layout (location = 1) in vec4 v_color;
+  layout (location = 0) in vec2 v_pos;
+  layout (location = 1) in vec4 v_pixel_color; // white unless a batch
+  layout (location = 2) in float v_coverage; // 1 unless anti-aliased
   uniform mat4 v_transform;
   uniform mat4 v_proj;
+  uniform vec4 v_color;
   out vec4 color;
   void main()
   {
-     gl_Position = v_transform * v_pos;
-     color = v_color;
+     gl_Position = v_transform * v_proj * vec4(v_pos, 0.0, 1.0);
+     color = v_color * v_pixel_color * vec4(1.0, 1.0, 1.0, v_coverage);
   }
 )";
 
@@ -53,11 +65,67 @@ const static char *fragment_shader_source = R"(
   }
 )";
 
-int compile_shaders(uint32_t *shader_program) {
+// One instanced quad per circle, the fragment shader keeps the pixels of the
+// midpoint outline using the closed form walk of circle_avx2, so the output
+// is the same as the rasterized points
+const static char *circle_vertex_shader_source = R"(
+  #version 330 core
+  layout (location = 0) in ivec2 i_center;
+  layout (location = 1) in uvec2 i_radius_end;
+  layout (location = 2) in vec4 i_color;
+  uniform mat4 v_transform;
+  uniform mat4 v_proj;
+  out vec2 window;
+  flat out ivec2 center;
+  flat out ivec2 radius_end;
+  flat out vec4 color;
+  void main()
+  {
+     // triangle strip corners from the vertex id, covering every pixel
+     // center of the outline
+     vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+     window = vec2(i_center) + 0.5 + corner * (float(i_radius_end.x) + 1.0);
+     center = i_center;
+     radius_end = ivec2(i_radius_end);
+     color = i_color;
+     gl_Position = v_transform * v_proj * vec4(window, 0.0, 1.0);
+  }
+)";
+
+const static char *circle_fragment_shader_source = R"(
+  #version 330 core
+  in vec2 window;
+  flat in ivec2 center;
+  flat in ivec2 radius_end;
+  flat in vec4 color;
+  out vec4 FragColor;
+  int ymax(int x, int r)
+  {
+     int k = r * r - x * x;
+     if (k <= 0) return -1;
+     int y = int((1.0 + sqrt(1.0 + 4.0 * float(k))) * 0.5);
+     if (y * (y - 1) >= k) y--;
+     if ((y + 1) * y < k) y++;
+     return y;
+  }
+  int walk_y(int x, int r)
+  {
+     return x == 0 ? r : max(ymax(x, r), ymax(x - 1, r) - 1);
+  }
+  void main()
+  {
+     ivec2 d = abs(ivec2(floor(window)) - center);
+     int r = radius_end.x, end = radius_end.y;
+     if (!((d.x <= end && d.y == walk_y(d.x, r)) || (d.y <= end && d.x == walk_y(d.y, r)))) discard;
+     FragColor = color;
+  }
+)";
+
+int compile_program(const char *vertex_source, const char *fragment_source, uint32_t *shader_program) {
 
   // vertex shader
   unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
+  glShaderSource(vertex_shader, 1, &vertex_source, NULL);
   glCompileShader(vertex_shader);
   // check for shader compile errors
   int success;
@@ -71,7 +139,7 @@ int compile_shaders(uint32_t *shader_program) {
     }
   // fragment shader
   uint32_t fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
+  glShaderSource(fragment_shader, 1, &fragment_source, NULL);
   glCompileShader(fragment_shader);
   // check for shader compile errors
   glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
@@ -98,10 +166,27 @@ int compile_shaders(uint32_t *shader_program) {
   return 0;
 }
 
+int compile_shaders(uint32_t *shader_program) {
+  return compile_program(vertex_shader_source, fragment_shader_source, shader_program);
+}
+
 typedef struct {
   double x, y;
 } Vec2;
 
+typedef struct {
+  int v_transform, v_proj, v_bord_color, v_color;
+} Uniforms;
+
+Uniforms get_uniforms(uint32_t program) {
+  return (Uniforms){
+    .v_transform = glGetUniformLocation(program, "v_transform"),
+    .v_proj = glGetUniformLocation(program, "v_proj"),
+    .v_bord_color = glGetUniformLocation(program, "v_bord_color"),
+    .v_color = glGetUniformLocation(program, "v_color"),
+  };
+}
+
 bool is_key_pressed(GLFWwindow *window, int keycode) {
     int state = glfwGetKey(window, keycode);
     return state == GLFW_PRESS || state == GLFW_REPEAT;
@@ -135,27 +220,39 @@ Vec2 get_mouse_pos(GLFWwindow *window) {
     return Vec2{ .x = xpos, .y = ypos };
 }
 
+// window coordinates, 4 bytes per pixel in the stream and on the gpu
 typedef struct {
-  glm::vec4 position;
-  glm::vec4 color;
-} Vertex;
+  int16_t x, y;
+} Pixel;
+
+// a horizontal run of pixels x0..x1 on row y
+typedef struct {
+  int y, x0, x1;
+} Span;
 
+// pixels is reserved once by circle_init and never grows past that, the
+// rasterizers drop what does not fit. color is a uniform
 typedef struct {
-  std::vector<int> pixels;
-  std::vector<uint32_t> idxs;
+  std::vector<Pixel> pixels; // points, or 6 quad corners per span
+  std::vector<uint8_t> coverage; // per pixel alpha, empty unless anti-aliased
+  std::vector<Span> spans;
+  uint32_t primitive; // GL_POINTS for pixels, GL_TRIANGLES for span quads
   glm::vec3 translate;
   glm::vec3 scale;
   glm::vec4 color;
 } Circle;
 
-uint32_t put_vertice(uint32_t idx, Vertex vertices[MAX_VERTEX_COUNT], glm::vec4 pos, glm::vec4 color) {
-  vertices[idx].position = pos;
-  vertices[idx].color = color;
-  return idx;
+void circle_init(Circle *c, uint32_t capacity) {
+  c->pixels.reserve(capacity);
+  c->coverage.reserve(capacity);
+  c->primitive = GL_POINTS;
+  c->translate = glm::vec3(0.0f);
+  c->scale = glm::vec3(1.0f);
+  c->color = glm::vec4(1.0f);
 }
 
-void print_vertex(Vertex v) {
-  std::cout << "vertex: " << glm::to_string(v.position) << std::endl;
+bool has_room(const Circle *c, uint32_t n) {
+  return c->pixels.size() + n <= c->pixels.capacity();
 }
 
 // mouse offset 1 -1
@@ -163,34 +260,160 @@ glm::vec3 mouse_to_gl_point(float x, float y) {
   return glm::vec3((2.0f * x) / WIDTH - 1.0f, 1.0f - (2.0f * y) / HEIGHT, 0.0f);
 }
 
-uint32_t add_pixel(Vertex *vertices, uint32_t idx, int x, int y, Circle *c) {
-    c->pixels.push_back(x);
-    c->pixels.push_back(y);
-    c->idxs.push_back(idx);
-    glm::vec3 pos = mouse_to_gl_point(x, y);
-    put_vertice(idx, vertices, glm::vec4(pos.x, pos.y, 0.0f, 1.0f), c->color);
-    idx++;
-    return idx;
+uint32_t add_pixel(Circle *c, int x, int y) {
+    if (!has_room(c, 1)) return 0;
+    c->pixels.push_back((Pixel){ .x = (int16_t)x, .y = (int16_t)y });
+    return 1;
+}
+
+uint32_t plot_circle_points(Circle *c, int centerX, int centerY, int x, int y) {
+  uint32_t n = 0;
+  n += add_pixel(c, centerX + x, centerY + y);
+  n += add_pixel(c, centerX - x, centerY + y);
+  n += add_pixel(c, centerX + x, centerY - y);
+  n += add_pixel(c, centerX - x, centerY - y);
+  n += add_pixel(c, centerX + y, centerY + x);
+  n += add_pixel(c, centerX - y, centerY + x);
+  n += add_pixel(c, centerX + y, centerY - x);
+  n += add_pixel(c, centerX - y, centerY - x);
+  return n;
+}
+
+// The midpoint walk in closed form. With ymax(x) the largest y where
+// x^2 + y (y - 1) < r^2, the walk is at y = max(ymax(x), ymax(x - 1) - 1)
+// after x steps, checked against the incremental walk up to radius 20000.
+// That lets a chunk of steps run in parallel lanes and each octant is
+// written with one store per chunk, octant after octant, so the order
+// inside a chunk differs from midpoint_circle_pixels but not the pixels.
+
+#define CIRCLE_LANES 8
+// below this the incremental walk is faster than the lane setup
+#define CIRCLE_SIMD_MIN_RADIUS 256
+
+int midpoint_ymax(int x, int radius) {
+  int64_t k = (int64_t)radius * radius - (int64_t)x * x;
+  if (k <= 0) return -1;
+  int64_t y = (int64_t)((1.0 + sqrt(1.0 + 4.0 * k)) / 2.0);
+  while (y * (y - 1) >= k) y--;
+  while ((y + 1) * y < k) y++;
+  return y;
 }
 
-uint32_t plot_circle_points(Vertex *vertices, uint32_t idx, Circle *c, int centerX, int centerY, int x, int y) {
-  idx = add_pixel(vertices, idx, centerX + x, centerY + y, c);
-  idx = add_pixel(vertices, idx, centerX - x, centerY + y, c);
-  idx = add_pixel(vertices, idx, centerX + x, centerY - y, c);
-  idx = add_pixel(vertices, idx, centerX - x, centerY - y, c);
-  idx = add_pixel(vertices, idx, centerX + y, centerY + x, c);
-  idx = add_pixel(vertices, idx, centerX - y, centerY + x, c);
-  idx = add_pixel(vertices, idx, centerX + y, centerY - x, c);
-  idx = add_pixel(vertices, idx, centerX - y, centerY - x, c);
-  return idx;
+int midpoint_y(int x, int radius) {
+  if (x == 0) return radius;
+  return std::max(midpoint_ymax(x, radius), midpoint_ymax(x - 1, radius) - 1);
 }
 
-uint32_t midpointCircle(Vertex *vertices, uint32_t idx, Circle *c, int centerX, int centerY, int radius) {
+// pixels midpointCircle emits for radius, 8 per step up to the first x >= y
+uint32_t midpoint_circle_count(int radius) {
+  if (radius <= 0) return 8;
+  int x = (int)(radius / sqrtf(2.0f));
+  while (x > 0 && x - 1 >= midpoint_y(x - 1, radius)) x--;
+  while (x < midpoint_y(x, radius)) x++;
+  return 8 * (x + 1);
+}
+
+typedef uint32_t (*CircleFn)(int cx, int cy, int radius, Pixel *out);
+
+// incremental walk, out needs midpoint_circle_count pixels
+uint32_t midpoint_circle_pixels(int cx, int cy, int radius, Pixel *out) {
+  int x = 0;
+  int y = radius;
+  int p = 1 - radius;
+  uint32_t n = 0;
+  while (true) {
+    Pixel octants[8] = {
+      { (int16_t)(cx + x), (int16_t)(cy + y) }, { (int16_t)(cx - x), (int16_t)(cy + y) },
+      { (int16_t)(cx + x), (int16_t)(cy - y) }, { (int16_t)(cx - x), (int16_t)(cy - y) },
+      { (int16_t)(cx + y), (int16_t)(cy + x) }, { (int16_t)(cx - y), (int16_t)(cy + x) },
+      { (int16_t)(cx + y), (int16_t)(cy - x) }, { (int16_t)(cx - y), (int16_t)(cy - x) },
+    };
+    memcpy(out + n, octants, sizeof(octants));
+    n += 8;
+    if (x >= y) break;
+    x++;
+    if (p < 0) {
+      p += 2 * x + 1;
+    } else {
+      y--;
+      p += 2 * x + 1 - 2 * y;
+    }
+  }
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+__m256i midpoint_ymax_avx2(__m256i x, __m256i r2) {
+  __m256i one = _mm256_set1_epi32(1);
+  __m256i k = _mm256_sub_epi32(r2, _mm256_mullo_epi32(x, x));
+  __m256 kf = _mm256_max_ps(_mm256_cvtepi32_ps(k), _mm256_setzero_ps());
+  __m256 root = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(kf, _mm256_set1_ps(4.0f)), _mm256_set1_ps(1.0f)));
+  __m256i y = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(root, _mm256_set1_ps(1.0f)), _mm256_set1_ps(0.5f)));
+  // one step of correction each way covers the float error
+  __m256i high = _mm256_cmpgt_epi32(k, _mm256_mullo_epi32(y, _mm256_sub_epi32(y, one)));
+  y = _mm256_add_epi32(y, _mm256_xor_si256(high, _mm256_set1_epi32(-1)));
+  __m256i low = _mm256_cmpgt_epi32(k, _mm256_mullo_epi32(_mm256_add_epi32(y, one), y));
+  y = _mm256_sub_epi32(y, low);
+  // no y when k <= 0
+  return _mm256_blendv_epi8(y, _mm256_set1_epi32(-1), _mm256_cmpgt_epi32(one, k));
+}
+
+__attribute__((target("avx2")))
+uint32_t circle_avx2(int cx, int cy, int radius, Pixel *out) {
+  if (radius < CIRCLE_SIMD_MIN_RADIUS) return midpoint_circle_pixels(cx, cy, radius, out);
+  __m256i r2 = _mm256_set1_epi32(radius * radius);
+  __m256i vcx = _mm256_set1_epi32(cx), vcy = _mm256_set1_epi32(cy);
+  __m256i one = _mm256_set1_epi32(1), mask = _mm256_set1_epi32(0xffff);
+  __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  uint32_t n = 0;
+  for (int x0 = 0;; x0 += CIRCLE_LANES) {
+    __m256i x = _mm256_add_epi32(_mm256_set1_epi32(x0), lane);
+    __m256i y = _mm256_max_epi32(midpoint_ymax_avx2(x, r2), _mm256_sub_epi32(midpoint_ymax_avx2(_mm256_sub_epi32(x, one), r2), one));
+    if (x0 == 0) y = _mm256_insert_epi32(y, radius, 0);
+    int stop = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_xor_si256(_mm256_cmpgt_epi32(y, x), _mm256_set1_epi32(-1))));
+    uint32_t valid = stop ? __builtin_ctz(stop) + 1 : CIRCLE_LANES;
+
+    __m256i octants[8] = {
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_add_epi32(vcy, y), 16), _mm256_and_si256(_mm256_add_epi32(vcx, x), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_add_epi32(vcy, y), 16), _mm256_and_si256(_mm256_sub_epi32(vcx, x), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_sub_epi32(vcy, y), 16), _mm256_and_si256(_mm256_add_epi32(vcx, x), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_sub_epi32(vcy, y), 16), _mm256_and_si256(_mm256_sub_epi32(vcx, x), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_add_epi32(vcy, x), 16), _mm256_and_si256(_mm256_add_epi32(vcx, y), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_add_epi32(vcy, x), 16), _mm256_and_si256(_mm256_sub_epi32(vcx, y), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_sub_epi32(vcy, x), 16), _mm256_and_si256(_mm256_add_epi32(vcx, y), mask)),
+      _mm256_or_si256(_mm256_slli_epi32(_mm256_sub_epi32(vcy, x), 16), _mm256_and_si256(_mm256_sub_epi32(vcx, y), mask)),
+    };
+    if (valid == CIRCLE_LANES) {
+      for (uint32_t k = 0; k < 8; k++) _mm256_storeu_si256((__m256i *)(out + n + CIRCLE_LANES * k), octants[k]);
+    } else {
+      // the last chunk, nothing is written past the count
+      for (uint32_t k = 0; k < 8; k++) memcpy(out + n + valid * k, &octants[k], valid * sizeof(Pixel));
+    }
+    n += 8 * valid;
+    if (stop) break;
+  }
+  return n;
+}
+#endif
+
+CircleFn select_circle() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return circle_avx2;
+#endif
+  return midpoint_circle_pixels;
+}
+
+CircleFn circle_pixels = select_circle();
+
+// one pixel at a time, for streams without room for the whole circle
+uint32_t plot_midpoint_circle(Circle *c, int centerX, int centerY, int radius) {
     int x = 0;
     int y = radius;
     int p = 1 - radius;
 
-    idx = plot_circle_points(vertices, idx, c, centerX, centerY, x, y);
+    uint32_t n = plot_circle_points(c, centerX, centerY, x, y);
 
     while (x < y) {
         x++;
@@ -200,42 +423,1315 @@ uint32_t midpointCircle(Vertex *vertices, uint32_t idx, Circle *c, int centerX,
             y--;
             p += 2 * x + 1 - 2 * y;
         }
-        idx = plot_circle_points(vertices, idx, c, centerX, centerY, x, y);
+        n += plot_circle_points(c, centerX, centerY, x, y);
+    }
+    return n;
+}
+
+uint32_t midpointCircle(Circle *c, int centerX, int centerY, int radius) {
+  uint32_t n = midpoint_circle_count(radius);
+  if (!has_room(c, n)) return plot_midpoint_circle(c, centerX, centerY, radius);
+  uint32_t first = c->pixels.size();
+  c->pixels.resize(first + n);
+  return circle_pixels(centerX, centerY, radius, &c->pixels[first]);
+}
+
+// Lines. Both rasterizers write into the Circle::pixels stream, one
+// pixel per step of the major axis, endpoints included. Half way ties round
+// towards the end point so the DDA output is the same as Bresenham.
+
+uint32_t line_length(int x0, int y0, int x1, int y1) {
+  return std::max(abs(x1 - x0), abs(y1 - y0)) + 1;
+}
+
+uint32_t bresenham_pixels(int x0, int y0, int x1, int y1, Pixel *out) {
+  int dx = abs(x1 - x0), dy = abs(y1 - y0);
+  int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+  bool steep = dy > dx;
+  int major = steep ? dy : dx, minor = steep ? dx : dy;
+  int d = 2 * minor - major;
+  int x = x0, y = y0;
+  for (int i = 0; i <= major; i++) {
+    out[i] = (Pixel){ .x = (int16_t)x, .y = (int16_t)y };
+    if (d >= 0) {
+      if (steep) x += sx;
+      else y += sy;
+      d -= 2 * major;
+    }
+    d += 2 * minor;
+    if (steep) y += sy;
+    else x += sx;
+  }
+  return major + 1;
+}
+
+// the DDA steps i = 0..major, minor offset floor(i * slope + bias). The bias
+// is 0.25 / major over one half, so ties round up, and a non tie is at least
+// 0.5 / major below the next integer. The offset is computed in double: its
+// error stays under 2^-30 for any major an int16 Pixel can reach, far below
+// that margin, so the output matches Bresenham at every length. In float the
+// error passes the margin from a major of about 2048 on
+typedef struct {
+  float major0, minor0, major_step, minor_step;
+  double slope, bias;
+  bool steep;
+  uint32_t count;
+} DdaSetup;
+
+DdaSetup dda_setup(int x0, int y0, int x1, int y1) {
+  int dx = abs(x1 - x0), dy = abs(y1 - y0);
+  float sx = x0 < x1 ? 1.0f : -1.0f, sy = y0 < y1 ? 1.0f : -1.0f;
+  DdaSetup d;
+  d.steep = dy > dx;
+  int major = d.steep ? dy : dx, minor = d.steep ? dx : dy;
+  d.major0 = d.steep ? y0 : x0;
+  d.minor0 = d.steep ? x0 : y0;
+  d.major_step = d.steep ? sy : sx;
+  d.minor_step = d.steep ? sx : sy;
+  d.slope = major == 0 ? 0.0 : (double)minor / major;
+  d.bias = major == 0 ? 0.5 : 0.5 + 0.25 / major;
+  d.count = major + 1;
+  return d;
+}
+
+// out needs room for line_length + DDA_LANES - 1 pixels, the SIMD kernels
+// write whole blocks
+#define DDA_LANES 8
+
+typedef uint32_t (*DdaFn)(int x0, int y0, int x1, int y1, Pixel *out);
+
+uint32_t dda_scalar(int x0, int y0, int x1, int y1, Pixel *out) {
+  DdaSetup d = dda_setup(x0, y0, x1, y1);
+  for (uint32_t i = 0; i < d.count; i++) {
+    int major = (int)(d.major0 + d.major_step * i);
+    int minor = (int)(d.minor0 + d.minor_step * (int)(i * d.slope + d.bias));
+    out[i] = (Pixel){ .x = (int16_t)(d.steep ? minor : major), .y = (int16_t)(d.steep ? major : minor) };
+  }
+  return d.count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+uint32_t dda_sse(int x0, int y0, int x1, int y1, Pixel *out) {
+  DdaSetup d = dda_setup(x0, y0, x1, y1);
+  __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  __m128 major0 = _mm_set1_ps(d.major0), minor0 = _mm_set1_ps(d.minor0);
+  __m128 major_step = _mm_set1_ps(d.major_step), minor_step = _mm_set1_ps(d.minor_step);
+  __m128d slope = _mm_set1_pd(d.slope), bias = _mm_set1_pd(d.bias);
+  __m128d lane_lo = _mm_setr_pd(0.0, 1.0), lane_hi = _mm_setr_pd(2.0, 3.0);
+
+  for (uint32_t i = 0; i < d.count; i += 4) {
+    __m128 fi = _mm_add_ps(_mm_set1_ps((float)i), lane);
+    // two doubles per register, the offset is positive so truncation is floor
+    __m128d di = _mm_set1_pd((double)i);
+    __m128i lo = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_add_pd(di, lane_lo), slope), bias));
+    __m128i hi = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_add_pd(di, lane_hi), slope), bias));
+    __m128 offset = _mm_cvtepi32_ps(_mm_unpacklo_epi64(lo, hi));
+    __m128i major = _mm_cvttps_epi32(_mm_add_ps(major0, _mm_mul_ps(fi, major_step)));
+    __m128i minor = _mm_cvttps_epi32(_mm_add_ps(minor0, _mm_mul_ps(offset, minor_step)));
+    __m128i x = d.steep ? minor : major, y = d.steep ? major : minor;
+    // little endian Pixel, x in the low half
+    __m128i pixel = _mm_or_si128(_mm_slli_epi32(y, 16), _mm_and_si128(x, _mm_set1_epi32(0xffff)));
+    _mm_storeu_si128((__m128i *)(out + i), pixel);
+  }
+  return d.count;
+}
+
+__attribute__((target("avx2")))
+uint32_t dda_avx2(int x0, int y0, int x1, int y1, Pixel *out) {
+  DdaSetup d = dda_setup(x0, y0, x1, y1);
+  __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  __m256 major0 = _mm256_set1_ps(d.major0), minor0 = _mm256_set1_ps(d.minor0);
+  __m256 major_step = _mm256_set1_ps(d.major_step), minor_step = _mm256_set1_ps(d.minor_step);
+  __m256d slope = _mm256_set1_pd(d.slope), bias = _mm256_set1_pd(d.bias);
+  __m256d lane_lo = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0), lane_hi = _mm256_setr_pd(4.0, 5.0, 6.0, 7.0);
+
+  for (uint32_t i = 0; i < d.count; i += 8) {
+    __m256 fi = _mm256_add_ps(_mm256_set1_ps((float)i), lane);
+    __m256d di = _mm256_set1_pd((double)i);
+    __m128i lo = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(di, lane_lo), slope), bias));
+    __m128i hi = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(di, lane_hi), slope), bias));
+    __m256 offset = _mm256_cvtepi32_ps(_mm256_set_m128i(hi, lo));
+    __m256i major = _mm256_cvttps_epi32(_mm256_add_ps(major0, _mm256_mul_ps(fi, major_step)));
+    __m256i minor = _mm256_cvttps_epi32(_mm256_add_ps(minor0, _mm256_mul_ps(offset, minor_step)));
+    __m256i x = d.steep ? minor : major, y = d.steep ? major : minor;
+    __m256i pixel = _mm256_or_si256(_mm256_slli_epi32(y, 16), _mm256_and_si256(x, _mm256_set1_epi32(0xffff)));
+    _mm256_storeu_si256((__m256i *)(out + i), pixel);
+  }
+  return d.count;
+}
+#endif
+
+DdaFn select_dda() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return dda_avx2;
+  if (__builtin_cpu_supports("sse2")) return dda_sse;
+#endif
+  return dda_scalar;
+}
+
+DdaFn dda_pixels = select_dda();
+
+// lines that do not fit in the stream are dropped whole
+uint32_t bresenham(Circle *c, int x0, int y0, int x1, int y1) {
+  uint32_t first = c->pixels.size();
+  uint32_t n = line_length(x0, y0, x1, y1);
+  if (!has_room(c, n)) return 0;
+  c->pixels.resize(first + n);
+  return bresenham_pixels(x0, y0, x1, y1, &c->pixels[first]);
+}
+
+uint32_t dda(Circle *c, int x0, int y0, int x1, int y1) {
+  uint32_t first = c->pixels.size();
+  uint32_t n = line_length(x0, y0, x1, y1);
+  if (!has_room(c, n + DDA_LANES - 1)) return 0;
+  c->pixels.resize(first + n + DDA_LANES - 1);
+  dda_pixels(x0, y0, x1, y1, &c->pixels[first]);
+  c->pixels.resize(first + n);
+  return n;
+}
+
+// Xiaolin Wu anti-aliasing. Two pixels per step across the ideal curve,
+// coverage split by the fractional distance to it, written to the pixel
+// stream with a coverage byte each. Lines emit the first end point pair,
+// the steps in between and then the last end point pair, circles 16 pixels
+// per step of the octant walk, fewer where mirrors coincide. The SIMD kernels
+// compute the same floats as the scalar ones, so the output is identical.
+
+#define WU_LANES 8
+
+uint8_t coverage_byte(float c) {
+  return (uint8_t)(int)(c * 255.0f + 0.5f);
+}
+
+typedef struct {
+  bool steep;
+  int x_first, x_last;      // major axis pixels of the end points
+  float intery, gradient;   // minor axis at x_first + 1
+  float y_first, y_last;    // minor axis at the end points
+  float gap_first, gap_last;
+} WuLine;
+
+WuLine wu_line_setup(float x0, float y0, float x1, float y1) {
+  WuLine l;
+  l.steep = fabsf(y1 - y0) > fabsf(x1 - x0);
+  if (l.steep) {
+    std::swap(x0, y0);
+    std::swap(x1, y1);
+  }
+  if (x0 > x1) {
+    std::swap(x0, x1);
+    std::swap(y0, y1);
+  }
+  float dx = x1 - x0;
+  l.gradient = dx == 0.0f ? 1.0f : (y1 - y0) / dx;
+
+  float x_end = floorf(x0 + 0.5f);
+  l.y_first = y0 + l.gradient * (x_end - x0);
+  l.gap_first = 1.0f - ((x0 + 0.5f) - floorf(x0 + 0.5f));
+  l.x_first = (int)x_end;
+  l.intery = l.y_first + l.gradient;
+
+  x_end = floorf(x1 + 0.5f);
+  l.y_last = y1 + l.gradient * (x_end - x1);
+  l.gap_last = (x1 + 0.5f) - floorf(x1 + 0.5f);
+  l.x_last = (int)x_end;
+  return l;
+}
+
+uint32_t wu_line_count(float x0, float y0, float x1, float y1) {
+  WuLine l = wu_line_setup(x0, y0, x1, y1);
+  return 4 + 2 * std::max(0, l.x_last - l.x_first - 1);
+}
+
+Pixel wu_pixel(bool steep, int major, int minor) {
+  return steep ? (Pixel){ (int16_t)minor, (int16_t)major } : (Pixel){ (int16_t)major, (int16_t)minor };
+}
+
+// pixel pair of an end point, weighted by its gap
+uint32_t wu_end_point(bool steep, int x, float y, float gap, Pixel *out, uint8_t *coverage) {
+  float f = y - floorf(y);
+  out[0] = wu_pixel(steep, x, (int)floorf(y));
+  out[1] = wu_pixel(steep, x, (int)floorf(y) + 1);
+  coverage[0] = coverage_byte((1.0f - f) * gap);
+  coverage[1] = coverage_byte(f * gap);
+  return 2;
+}
+
+typedef uint32_t (*WuLineFn)(float x0, float y0, float x1, float y1, Pixel *out, uint8_t *coverage);
+
+// out and coverage need wu_line_count entries
+uint32_t wu_line_scalar(float x0, float y0, float x1, float y1, Pixel *out, uint8_t *coverage) {
+  WuLine l = wu_line_setup(x0, y0, x1, y1);
+  uint32_t n = wu_end_point(l.steep, l.x_first, l.y_first, l.gap_first, out, coverage);
+  for (int i = 0; l.x_first + 1 + i < l.x_last; i++) {
+    float y = l.intery + l.gradient * (float)i;
+    float f = y - floorf(y);
+    out[n] = wu_pixel(l.steep, l.x_first + 1 + i, (int)floorf(y));
+    out[n + 1] = wu_pixel(l.steep, l.x_first + 1 + i, (int)floorf(y) + 1);
+    coverage[n] = coverage_byte(1.0f - f);
+    coverage[n + 1] = coverage_byte(f);
+    n += 2;
+  }
+  n += wu_end_point(l.steep, l.x_last, l.y_last, l.gap_last, out + n, coverage + n);
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+__m256i pack_pixels_avx2(__m256i x, __m256i y) {
+  return _mm256_or_si256(_mm256_slli_epi32(y, 16), _mm256_and_si256(x, _mm256_set1_epi32(0xffff)));
+}
+
+__attribute__((target("avx2")))
+__m256i coverage_avx2(__m256 c) {
+  return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+__attribute__((target("avx2")))
+uint32_t wu_line_avx2(float x0, float y0, float x1, float y1, Pixel *out, uint8_t *coverage) {
+  WuLine l = wu_line_setup(x0, y0, x1, y1);
+  uint32_t n = wu_end_point(l.steep, l.x_first, l.y_first, l.gap_first, out, coverage);
+  int steps = std::max(0, l.x_last - l.x_first - 1);
+  __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  __m256i one = _mm256_set1_epi32(1);
+  for (int i = 0; i < steps; i += WU_LANES) {
+    __m256 fi = _mm256_add_ps(_mm256_set1_ps((float)i), lane);
+    __m256 y = _mm256_add_ps(_mm256_set1_ps(l.intery), _mm256_mul_ps(_mm256_set1_ps(l.gradient), fi));
+    __m256 y_floor = _mm256_floor_ps(y);
+    __m256 f = _mm256_sub_ps(y, y_floor);
+    __m256i major = _mm256_add_epi32(_mm256_set1_epi32(l.x_first + 1), _mm256_cvttps_epi32(fi));
+    __m256i minor = _mm256_cvtps_epi32(y_floor);
+    __m256i near = l.steep ? pack_pixels_avx2(minor, major) : pack_pixels_avx2(major, minor);
+    __m256i far = l.steep ? pack_pixels_avx2(_mm256_add_epi32(minor, one), major) : pack_pixels_avx2(major, _mm256_add_epi32(minor, one));
+    // pairs per step, unpack works per 128 bit half
+    __m256i lo = _mm256_unpacklo_epi32(near, far), hi = _mm256_unpackhi_epi32(near, far);
+    __m256i pairs = _mm256_or_si256(coverage_avx2(_mm256_sub_ps(_mm256_set1_ps(1.0f), f)), _mm256_slli_epi32(coverage_avx2(f), 8));
+    __m128i bytes = _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi32(pairs, pairs), 0x08));
+
+    uint32_t valid = std::min(WU_LANES, steps - i);
+    if (valid == WU_LANES) {
+      _mm256_storeu_si256((__m256i *)(out + n), _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i *)(out + n + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+      _mm_storeu_si128((__m128i *)(coverage + n), bytes);
+    } else {
+      Pixel tmp[2 * WU_LANES];
+      uint8_t tmp_coverage[2 * WU_LANES];
+      _mm256_storeu_si256((__m256i *)tmp, _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i *)(tmp + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+      _mm_storeu_si128((__m128i *)tmp_coverage, bytes);
+      memcpy(out + n, tmp, 2 * valid * sizeof(Pixel));
+      memcpy(coverage + n, tmp_coverage, 2 * valid);
+    }
+    n += 2 * valid;
+  }
+  n += wu_end_point(l.steep, l.x_last, l.y_last, l.gap_last, out + n, coverage + n);
+  return n;
+}
+#endif
+
+WuLineFn select_wu_line() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return wu_line_avx2;
+#endif
+  return wu_line_scalar;
+}
+
+WuLineFn wu_line_pixels = select_wu_line();
+
+// steps x = 0..last with x <= sqrt(r^2 - x^2)
+int wu_circle_last(float radius) {
+  int x = (int)(radius * 0.70710678f);
+  while (x > 0 && 2.0 * x * x > (double)radius * radius) x--;
+  while (2.0 * (x + 1) * (x + 1) <= (double)radius * radius) x++;
+  return x;
+}
+
+float wu_circle_y(float radius, int x) {
+  return sqrtf(radius * radius - (float)x * (float)x);
+}
+
+// 16 per step, x = 0 keeps 4 of the 8 mirrors of each pixel and so does the
+// near pixel of the last step when it lands on the diagonal
+uint32_t wu_circle_count(float radius) {
+  int last = wu_circle_last(radius);
+  uint32_t n = 16 * (last + 1) - 8;
+  if (floorf(wu_circle_y(radius, 0)) == 0.0f) n -= 3; // the near pixel is the center itself
+  if (last > 0 && floorf(wu_circle_y(radius, last)) == (float)last) n -= 4;
+  return n;
+}
+
+typedef uint32_t (*WuCircleFn)(int cx, int cy, float radius, Pixel *out, uint8_t *coverage);
+
+// the near and far pixel of step x in octant order, mirrors that fall on the
+// same pixel are written once
+uint32_t wu_circle_step(int cx, int cy, int x, float y, Pixel *out, uint8_t *coverage) {
+  int y_floor = (int)floorf(y);
+  float f = y - floorf(y);
+  uint32_t n = 0;
+  for (int k = 0; k < 2; k++) {
+    int y0 = y_floor + k;
+    Pixel octants[8] = {
+      { (int16_t)(cx + x), (int16_t)(cy + y0) }, { (int16_t)(cx - x), (int16_t)(cy + y0) },
+      { (int16_t)(cx + x), (int16_t)(cy - y0) }, { (int16_t)(cx - x), (int16_t)(cy - y0) },
+      { (int16_t)(cx + y0), (int16_t)(cy + x) }, { (int16_t)(cx - y0), (int16_t)(cy + x) },
+      { (int16_t)(cx + y0), (int16_t)(cy - x) }, { (int16_t)(cx - y0), (int16_t)(cy - x) },
+    };
+    uint32_t unique = 0xff;
+    if (x == 0) unique &= 0x35;  // -x is +x
+    if (y0 == 0) unique &= 0x53; // -y0 is +y0
+    if (y0 == x) unique &= 0x0f; // the swapped half repeats the first
+    uint8_t c = coverage_byte(k == 0 ? 1.0f - f : f);
+    if (unique == 0xff) {
+      memcpy(out + n, octants, sizeof(octants));
+      memset(coverage + n, c, 8);
+      n += 8;
+      continue;
+    }
+    for (uint32_t o = 0; o < 8; o++) {
+      if (!(unique & (1u << o))) continue;
+      out[n] = octants[o];
+      coverage[n++] = c;
+    }
+  }
+  return n;
+}
+
+// octant order of midpoint_circle_pixels, the near pixel of a step and then
+// the far one
+uint32_t wu_circle_scalar(int cx, int cy, float radius, Pixel *out, uint8_t *coverage) {
+  int last = wu_circle_last(radius);
+  uint32_t n = 0;
+  for (int x = 0; x <= last; x++) n += wu_circle_step(cx, cy, x, wu_circle_y(radius, x), out + n, coverage + n);
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// a chunk of steps per store, octant after octant like circle_avx2. The
+// first and last step, the only ones whose mirrors can coincide, go through
+// wu_circle_step
+__attribute__((target("avx2")))
+uint32_t wu_circle_avx2(int cx, int cy, float radius, Pixel *out, uint8_t *coverage) {
+  int last = wu_circle_last(radius);
+  __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  __m256 r2 = _mm256_set1_ps(radius * radius);
+  __m256i vcx = _mm256_set1_epi32(cx), vcy = _mm256_set1_epi32(cy);
+  uint32_t n = wu_circle_step(cx, cy, 0, wu_circle_y(radius, 0), out, coverage);
+  for (int x0 = 1; x0 < last; x0 += WU_LANES) {
+    __m256 fx = _mm256_add_ps(_mm256_set1_ps((float)x0), lane);
+    __m256 y = _mm256_sqrt_ps(_mm256_sub_ps(r2, _mm256_mul_ps(fx, fx)));
+    __m256 y_floor = _mm256_floor_ps(y);
+    __m256 f = _mm256_sub_ps(y, y_floor);
+    __m256i x = _mm256_cvttps_epi32(fx);
+    __m256i covers[2] = { coverage_avx2(_mm256_sub_ps(_mm256_set1_ps(1.0f), f)), coverage_avx2(f) };
+    uint32_t valid = std::min(WU_LANES, last - x0);
+
+    for (int k = 0; k < 2; k++) {
+      __m256i y0 = _mm256_add_epi32(_mm256_cvtps_epi32(y_floor), _mm256_set1_epi32(k));
+      __m256i octants[8] = {
+        pack_pixels_avx2(_mm256_add_epi32(vcx, x), _mm256_add_epi32(vcy, y0)), pack_pixels_avx2(_mm256_sub_epi32(vcx, x), _mm256_add_epi32(vcy, y0)),
+        pack_pixels_avx2(_mm256_add_epi32(vcx, x), _mm256_sub_epi32(vcy, y0)), pack_pixels_avx2(_mm256_sub_epi32(vcx, x), _mm256_sub_epi32(vcy, y0)),
+        pack_pixels_avx2(_mm256_add_epi32(vcx, y0), _mm256_add_epi32(vcy, x)), pack_pixels_avx2(_mm256_sub_epi32(vcx, y0), _mm256_add_epi32(vcy, x)),
+        pack_pixels_avx2(_mm256_add_epi32(vcx, y0), _mm256_sub_epi32(vcy, x)), pack_pixels_avx2(_mm256_sub_epi32(vcx, y0), _mm256_sub_epi32(vcy, x)),
+      };
+      // 8 coverage bytes, the same for every octant
+      __m256i words = _mm256_packus_epi32(covers[k], covers[k]);
+      __m256i packed = _mm256_packus_epi16(words, words);
+      __m128i bytes = _mm_unpacklo_epi32(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+      for (uint32_t o = 0; o < 8; o++) {
+        if (valid == WU_LANES) {
+          _mm256_storeu_si256((__m256i *)(out + n), octants[o]);
+          _mm_storel_epi64((__m128i *)(coverage + n), bytes);
+        } else {
+          memcpy(out + n, &octants[o], valid * sizeof(Pixel));
+          memcpy(coverage + n, &bytes, valid);
+        }
+        n += valid;
+      }
     }
-    return idx;
+  }
+  if (last > 0) n += wu_circle_step(cx, cy, last, wu_circle_y(radius, last), out + n, coverage + n);
+  return n;
+}
+#endif
+
+WuCircleFn select_wu_circle() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return wu_circle_avx2;
+#endif
+  return wu_circle_scalar;
+}
+
+WuCircleFn wu_circle_pixels = select_wu_circle();
+
+// pixels added without coverage are opaque
+void pad_coverage(Circle *c) {
+  if (c->coverage.size() < c->pixels.size()) c->coverage.resize(c->pixels.size(), 255);
+}
+
+uint32_t wu_line(Circle *c, float x0, float y0, float x1, float y1) {
+  uint32_t n = wu_line_count(x0, y0, x1, y1);
+  if (!has_room(c, n)) return 0;
+  pad_coverage(c);
+  uint32_t first = c->pixels.size();
+  c->pixels.resize(first + n);
+  c->coverage.resize(first + n);
+  return wu_line_pixels(x0, y0, x1, y1, &c->pixels[first], &c->coverage[first]);
+}
+
+uint32_t wu_circle(Circle *c, int cx, int cy, float radius) {
+  uint32_t n = wu_circle_count(radius);
+  if (!has_room(c, n)) return 0;
+  pad_coverage(c);
+  uint32_t first = c->pixels.size();
+  c->pixels.resize(first + n);
+  c->coverage.resize(first + n);
+  return wu_circle_pixels(cx, cy, radius, &c->pixels[first], &c->coverage[first]);
+}
+
+// Filled shapes as one span per row. The half widths come from the same
+// midpoint walk as the outline, spans[first + dy + r] is row cy + dy.
+
+void widen_span(Span *row, int cx, int half) {
+  row->x0 = std::min(row->x0, cx - half);
+  row->x1 = std::max(row->x1, cx + half);
+}
+
+uint32_t reset_spans(std::vector<Span> *spans, int cx, int cy, int r) {
+  uint32_t first = spans->size();
+  spans->resize(first + 2 * r + 1);
+  for (int dy = -r; dy <= r; dy++) (*spans)[first + dy + r] = (Span){ .y = cy + dy, .x0 = cx, .x1 = cx };
+  return first;
 }
 
-void print_circle(Circle c) {
+uint32_t disk_spans(int cx, int cy, int radius, std::vector<Span> *spans) {
+  uint32_t first = reset_spans(spans, cx, cy, radius);
+  Span *rows = &(*spans)[first + radius];
+  int x = 0;
+  int y = radius;
+  int p = 1 - radius;
+  while (true) {
+    widen_span(&rows[y], cx, x);
+    widen_span(&rows[-y], cx, x);
+    widen_span(&rows[x], cx, y);
+    widen_span(&rows[-x], cx, y);
+    if (x >= y) break;
+    x++;
+    if (p < 0) {
+      p += 2 * x + 1;
+    } else {
+      y--;
+      p += 2 * x + 1 - 2 * y;
+    }
+  }
+  return 2 * radius + 1;
+}
+
+// midpoint ellipse, decisions scaled by 4 to stay in integers
+uint32_t ellipse_spans(int cx, int cy, int rx, int ry, std::vector<Span> *spans) {
+  uint32_t first = reset_spans(spans, cx, cy, ry);
+  Span *rows = &(*spans)[first + ry];
+  if (ry == 0) {
+    widen_span(&rows[0], cx, rx);
+    return 1;
+  }
+  int64_t rx2 = (int64_t)rx * rx, ry2 = (int64_t)ry * ry;
+  int64_t x = 0, y = ry;
+  int64_t px = 0, py = 2 * rx2 * y;
+
+  // region 1, slope above -1
+  int64_t p = 4 * ry2 - 4 * rx2 * ry + rx2;
+  while (px < py) {
+    widen_span(&rows[y], cx, x);
+    widen_span(&rows[-y], cx, x);
+    x++;
+    px += 2 * ry2;
+    if (p < 0) {
+      p += 4 * (ry2 + px);
+    } else {
+      y--;
+      py -= 2 * rx2;
+      p += 4 * (ry2 + px - py);
+    }
+  }
+
+  // region 2
+  p = ry2 * (2 * x + 1) * (2 * x + 1) + 4 * rx2 * (y - 1) * (y - 1) - 4 * rx2 * ry2;
+  while (y >= 0) {
+    widen_span(&rows[y], cx, x);
+    widen_span(&rows[-y], cx, x);
+    y--;
+    py -= 2 * rx2;
+    if (p > 0) {
+      p += 4 * (rx2 - py);
+    } else {
+      x++;
+      px += 2 * ry2;
+      p += 4 * (rx2 - py + px);
+    }
+  }
+  return 2 * ry + 1;
+}
+
+// two triangles per span covering whole pixels
+uint32_t put_spans(Circle *c) {
+  uint32_t n = 0;
+  for (Span s : c->spans) {
+    if (!has_room(c, 6)) break;
+    int16_t x0 = s.x0, y0 = s.y, x1 = s.x1 + 1, y1 = s.y + 1;
+    Pixel quad[6] = {
+      { x0, y0 }, { x1, y0 }, { x1, y1 },
+      { x0, y0 }, { x1, y1 }, { x0, y1 },
+    };
+    c->pixels.insert(c->pixels.end(), quad, quad + 6);
+    n += 6;
+  }
+  return n;
+}
+
+// Circle batches. Every circle gets its exact midpoint pixel count, a prefix
+// sum turns the counts into offsets and the circles are rasterized in
+// parallel straight into their slice of one shared stream, colors packed
+// next to it, drawn with a single call.
+
+#define BATCH_CHUNK 64
+
+typedef struct {
+  int x, y, radius;
+  glm::vec4 color;
+} BatchCircle;
+
+typedef struct {
+  std::vector<BatchCircle> circles;
+  std::vector<uint32_t> offsets; // circles.size() + 1
+  // kept at their high water mark, entries past count are stale
+  std::vector<Pixel> pixels;
+  std::vector<uint32_t> colors; // rgba8
+  uint32_t count;
+} CircleBatch;
+
+typedef struct {
+  std::mutex lock;
+  std::deque<uint32_t> items;
+} WorkQueue;
+
+bool work_queue_pop(std::vector<WorkQueue> *queues, uint32_t id, uint32_t *item) {
+  {
+    WorkQueue *own = &(*queues)[id];
+    std::lock_guard<std::mutex> guard(own->lock);
+    if (!own->items.empty()) {
+      *item = own->items.back();
+      own->items.pop_back();
+      return true;
+    }
+  }
+  // own queue is empty, steal from the front of the others
+  for (uint32_t i = 1; i < queues->size(); i++) {
+    WorkQueue *victim = &(*queues)[(id + i) % queues->size()];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (!victim->items.empty()) {
+      *item = victim->items.front();
+      victim->items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+// runs fn(item) for item in [0, count) on a work-stealing pool
+void parallel_for(uint32_t count, uint32_t threads, const std::function<void(uint32_t)> &fn) {
+  if (threads == 0) threads = 1;
+  if (threads == 1 || count <= 1) {
+    for (uint32_t i = 0; i < count; i++) fn(i);
+    return;
+  }
+  std::vector<WorkQueue> queues(threads);
+  for (uint32_t i = 0; i < count; i++) {
+    queues[i * threads / count].items.push_back(i);
+  }
+
+  std::vector<std::thread> workers;
+  for (uint32_t id = 0; id < threads; id++) {
+    workers.emplace_back([&queues, &fn, id]() {
+      uint32_t item;
+      while (work_queue_pop(&queues, id, &item)) fn(item);
+    });
+  }
+  for (auto &w : workers) w.join();
+}
+
+uint32_t pack_color(glm::vec4 c) {
+  uint32_t r = (uint32_t)(glm::clamp(c.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+  uint32_t g = (uint32_t)(glm::clamp(c.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+  uint32_t b = (uint32_t)(glm::clamp(c.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+  uint32_t a = (uint32_t)(glm::clamp(c.a, 0.0f, 1.0f) * 255.0f + 0.5f);
+  return r | g << 8 | b << 16 | a << 24;
+}
+
+uint32_t circle_batch_rasterize(CircleBatch *b, uint32_t threads) {
+  uint32_t n = b->circles.size();
+  uint32_t chunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+  b->offsets.resize(n + 1);
+  b->offsets[0] = 0;
+  parallel_for(chunks, threads, [b, n](uint32_t chunk) {
+    for (uint32_t i = chunk * BATCH_CHUNK; i < std::min(n, (chunk + 1) * BATCH_CHUNK); i++) {
+      b->offsets[i + 1] = midpoint_circle_count(b->circles[i].radius);
+    }
+  });
+  for (uint32_t i = 0; i < n; i++) b->offsets[i + 1] += b->offsets[i];
+
+  b->count = b->offsets[n];
+  if (b->pixels.size() < b->count) {
+    b->pixels.resize(b->count);
+    b->colors.resize(b->count);
+  }
+  parallel_for(chunks, threads, [b, n](uint32_t chunk) {
+    for (uint32_t i = chunk * BATCH_CHUNK; i < std::min(n, (chunk + 1) * BATCH_CHUNK); i++) {
+      BatchCircle c = b->circles[i];
+      uint32_t first = b->offsets[i];
+      uint32_t count = circle_pixels(c.x, c.y, c.radius, &b->pixels[first]);
+      std::fill(b->colors.begin() + first, b->colors.begin() + first + count, pack_color(c.color));
+    }
+  });
+  return b->count;
+}
+
+void print_circle(const Circle &c) {
   std::cout <<  "circle: " << std::endl;
-  std::cout << c.idxs.size() << std::endl;
   std::cout << c.pixels.size() << std::endl;
+  std::cout << c.spans.size() << std::endl;
   std::cout <<  "end" << std::endl;
 }
 
-void draw_triangles(uint32_t VAO, uint32_t program, Circle c) {
-  if (!c.pixels.empty()) {
-    print_circle(c);
-    glPointSize(2.0f);
-    int v_transform = glGetUniformLocation(program, "v_transform");
-    int v_proj = glGetUniformLocation(program, "v_proj");
+// offset moves points to their pixel center, span quads sit on pixel edges
+void set_uniforms(const Uniforms &u, glm::vec3 translate, glm::vec3 scale, glm::vec4 color, float offset) {
+  // window coordinates, y down like mouse_to_gl_point
+  glm::mat4 projection = glm::ortho(0.0f, (float)WIDTH, (float)HEIGHT, 0.0f, -1.0f, 1.0f);
+  projection = glm::translate(projection, glm::vec3(offset, offset, 0.0f));
+  glm::mat4 transform = glm::translate(glm::mat4(1.0f), translate) * glm::scale(glm::mat4(1.0f), scale);
+
+  glUniformMatrix4fv(u.v_transform, 1, GL_FALSE, &transform[0][0]);
+  glUniformMatrix4fv(u.v_proj, 1, GL_FALSE, &projection[0][0]);
+  glUniform4f(u.v_bord_color, -1.0f, -1.0f, -1.0f, -1.0f);
+  glUniform4f(u.v_color, color.r, color.g, color.b, color.a);
+}
 
-    glm::mat4 projection = glm::ortho(0.0f, (float)WIDTH, 0.0f, (float)HEIGHT, -1.0f, 1.0f);
-    
-    glm::mat4 translate = glm::translate(glm::mat4(1.0f), c.translate);
-    glm::mat4 scale = glm::scale(glm::mat4(1.0f), c.scale);
-    glm::mat4 transform = translate * scale;
-    int v_bord_color = glGetUniformLocation(program, "v_bord_color");
-    
-    glUniformMatrix4fv(v_transform, 1, GL_FALSE, &transform[0][0]);
-    glUniformMatrix4fv(v_proj, 1, GL_FALSE, &projection[0][0]);
-    glUniform4f(v_bord_color, -1.0f, -1.0f, -1.0f, -1.0f);
+void draw_triangles(uint32_t VAO, const Uniforms &u, const Circle &c) {
+  if (!c.pixels.empty()) {
+    // anti-aliased pixels only cover their own pixel
+    glPointSize(c.coverage.empty() ? 2.0f : 1.0f);
+    set_uniforms(u, c.translate, c.scale, c.color, c.primitive == GL_POINTS ? 0.5f : 0.0f);
     glBindVertexArray(VAO);
+    if (c.coverage.empty()) glDisableVertexAttribArray(2);
+    else glEnableVertexAttribArray(2);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glDrawArrays(GL_POINTS, c.idxs[0], c.idxs.size());
+    glDrawArrays(c.primitive, 0, c.pixels.size());
     //glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
   }
 }
 
+typedef struct {
+  uint32_t VAO, pixels, colors;
+  uint32_t capacity;
+} BatchBuffers;
+
+void batch_buffers_init(BatchBuffers *g) {
+  glGenVertexArrays(1, &g->VAO);
+  glGenBuffers(1, &g->pixels);
+  glGenBuffers(1, &g->colors);
+  g->capacity = 0;
+
+  glBindVertexArray(g->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, g->pixels);
+  glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(Pixel), (void*)offsetof(Pixel, x));
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, g->colors);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(uint32_t), (void*)0);
+  glEnableVertexAttribArray(1);
+  glBindVertexArray(0);
+}
+
+// the buffers only grow, otherwise only the used range is written
+void batch_upload(BatchBuffers *g, const CircleBatch &b) {
+  if (b.count > g->capacity) {
+    g->capacity = std::max(b.count, 2 * g->capacity);
+    glBindBuffer(GL_ARRAY_BUFFER, g->pixels);
+    glBufferData(GL_ARRAY_BUFFER, g->capacity * sizeof(Pixel), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, g->colors);
+    glBufferData(GL_ARRAY_BUFFER, g->capacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, g->pixels);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, b.count * sizeof(Pixel), b.pixels.data());
+  glBindBuffer(GL_ARRAY_BUFFER, g->colors);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, b.count * sizeof(uint32_t), b.colors.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void draw_batch(const BatchBuffers &g, const Uniforms &u, const CircleBatch &b, glm::vec3 translate, glm::vec3 scale, float point_size) {
+  if (b.count == 0) return;
+  glPointSize(point_size);
+  set_uniforms(u, translate, scale, glm::vec4(1.0f), 0.5f);
+  glBindVertexArray(g.VAO);
+  glDrawArrays(GL_POINTS, 0, b.count);
+}
+
+typedef struct {
+  int16_t x, y;
+  uint16_t radius, end; // end is the last x of the octant walk
+  uint32_t color;
+} CircleInstance;
+
+typedef struct {
+  uint32_t VAO, VBO;
+  uint32_t capacity;
+} InstanceBuffers;
+
+uint32_t circle_instances(const CircleBatch &b, std::vector<CircleInstance> *out) {
+  out->resize(b.circles.size());
+  for (uint32_t i = 0; i < b.circles.size(); i++) {
+    BatchCircle c = b.circles[i];
+    (*out)[i] = (CircleInstance){
+      .x = (int16_t)c.x, .y = (int16_t)c.y,
+      .radius = (uint16_t)c.radius, .end = (uint16_t)(midpoint_circle_count(c.radius) / 8 - 1),
+      .color = pack_color(c.color),
+    };
+  }
+  return out->size();
+}
+
+void instance_buffers_init(InstanceBuffers *g) {
+  glGenVertexArrays(1, &g->VAO);
+  glGenBuffers(1, &g->VBO);
+  g->capacity = 0;
+
+  glBindVertexArray(g->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, g->VBO);
+  glVertexAttribIPointer(0, 2, GL_SHORT, sizeof(CircleInstance), (void*)offsetof(CircleInstance, x));
+  glVertexAttribIPointer(1, 2, GL_UNSIGNED_SHORT, sizeof(CircleInstance), (void*)offsetof(CircleInstance, radius));
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CircleInstance), (void*)offsetof(CircleInstance, color));
+  for (uint32_t i = 0; i < 3; i++) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void instance_upload(InstanceBuffers *g, const std::vector<CircleInstance> &instances) {
+  glBindBuffer(GL_ARRAY_BUFFER, g->VBO);
+  if (instances.size() > g->capacity) {
+    g->capacity = std::max((uint32_t)instances.size(), 2 * g->capacity);
+    glBufferData(GL_ARRAY_BUFFER, g->capacity * sizeof(CircleInstance), nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(CircleInstance), instances.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void draw_instances(const InstanceBuffers &g, const Uniforms &u, uint32_t count, glm::vec3 translate, glm::vec3 scale) {
+  if (count == 0) return;
+  set_uniforms(u, translate, scale, glm::vec4(1.0f), 0.0f);
+  glBindVertexArray(g.VAO);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
+
+void random_batch(std::mt19937 *rng, uint32_t count, std::vector<BatchCircle> *circles) {
+  std::uniform_int_distribution<int> px(0, WIDTH - 1), py(0, HEIGHT - 1), radius(1, 150);
+  std::uniform_real_distribution<float> channel(0.2f, 1.0f);
+  for (uint32_t i = 0; i < count; i++) {
+    circles->push_back((BatchCircle){
+      .x = px(*rng), .y = py(*rng), .radius = radius(*rng),
+      .color = glm::vec4(channel(*rng), channel(*rng), channel(*rng), 1.0f),
+    });
+  }
+}
+
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int bench_lines(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> px(0, WIDTH - 1), py(0, HEIGHT - 1);
+  std::vector<int> segments(4 * count);
+  for (uint32_t i = 0; i < count; i++) {
+    segments[4 * i] = px(rng);
+    segments[4 * i + 1] = py(rng);
+    segments[4 * i + 2] = px(rng);
+    segments[4 * i + 3] = py(rng);
+  }
+  // some axis aligned, diagonal and single pixel ones
+  for (uint32_t i = 0; i < count; i += 8) segments[4 * i + 2] = segments[4 * i];
+  for (uint32_t i = 2; i < count; i += 8) segments[4 * i + 3] = segments[4 * i + 1];
+  for (uint32_t i = 4; i < count; i += 8) segments[4 * i + 3] = segments[4 * i + 1] + (segments[4 * i + 2] - segments[4 * i]);
+  for (uint32_t i = 6; i < count; i += 64) segments[4 * i + 2] = segments[4 * i], segments[4 * i + 3] = segments[4 * i + 1];
+  // every 16th one far past the window, major axis up to the int16 range,
+  // like a software backend with a large framebuffer would draw
+  std::uniform_int_distribution<int> far(-32768, 32767);
+  for (uint32_t i = 1; i < count; i += 16) {
+    for (int k = 0; k < 4; k++) segments[4 * i + k] = far(rng);
+  }
+  // the shortest line float offsets got wrong
+  if (count > 3) segments[4 * 3] = 0, segments[4 * 3 + 1] = 0, segments[4 * 3 + 2] = 2051, segments[4 * 3 + 3] = 1282;
+
+  uint32_t max_length = 65536;
+  std::vector<Pixel> a(max_length + DDA_LANES), b(max_length + DDA_LANES);
+  uint32_t mismatches = 0;
+  uint64_t pixels = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const int *s = &segments[4 * i];
+    uint32_t n = bresenham_pixels(s[0], s[1], s[2], s[3], a.data());
+    pixels += n;
+    if (dda_pixels(s[0], s[1], s[2], s[3], b.data()) != n || memcmp(a.data(), b.data(), n * sizeof(Pixel)) != 0) mismatches++;
+    if (a[0].x != s[0] || a[0].y != s[1] || a[n - 1].x != s[2] || a[n - 1].y != s[3]) mismatches++;
+  }
+
+  struct { const char *name; DdaFn fn; bool supported; } kernels[] = {
+    { "bresenham", bresenham_pixels, true },
+    { "dda scalar", dda_scalar, true },
+#if defined(__x86_64__) || defined(__i386__)
+    { "dda sse", dda_sse, (bool)__builtin_cpu_supports("sse2") },
+    { "dda avx2", dda_avx2, (bool)__builtin_cpu_supports("avx2") },
+#endif
+  };
+  double bresenham_ms = 0.0;
+  for (auto &k : kernels) {
+    if (!k.supported) continue;
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++) {
+      const int *s = &segments[4 * i];
+      uint32_t n = k.fn(s[0], s[1], s[2], s[3], a.data());
+      checksum += a[n - 1].x + n;
+    }
+    double ms = elapsed_ms(start);
+    if (k.fn == bresenham_pixels) bresenham_ms = ms;
+    std::cout << k.name << ": " << pixels / ms / 1000.0 << " Mpixels/s, " << bresenham_ms / ms << "x (" << checksum << ")" << std::endl;
+  }
+
+  // through the pixel stream
+  uint32_t stream_count = std::min(count, 10000u);
+  Circle c;
+  circle_init(&c, max_length + DDA_LANES);
+  uint64_t stream_pixels = 0;
+  for (uint32_t k = 0; k < 2; k++) {
+    auto start = std::chrono::steady_clock::now();
+    stream_pixels = 0;
+    for (uint32_t i = 0; i < stream_count; i++) {
+      const int *s = &segments[4 * i];
+      c.pixels.clear();
+      if (k == 0) stream_pixels += bresenham(&c, s[0], s[1], s[2], s[3]);
+      else stream_pixels += dda(&c, s[0], s[1], s[2], s[3]);
+    }
+    std::cout << (k == 0 ? "bresenham" : "dda") << " stream: " << stream_pixels / elapsed_ms(start) / 1000.0 << " Mpixels/s" << std::endl;
+  }
+
+  std::cout << "segments: " << count << ", pixels: " << pixels << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+// row extents of the midpoint outline, the filled disk has to match them
+int check_disk(const std::vector<Span> &spans, uint32_t first, int cx, int cy, int r) {
+  Circle outline;
+  circle_init(&outline, 8 * (r + 1));
+  midpointCircle(&outline, cx, cy, r);
+  std::vector<Span> rows(2 * r + 1, (Span){ .y = 0, .x0 = cx + r + 1, .x1 = cx - r - 1 });
+  for (Pixel p : outline.pixels) {
+    Span *row = &rows[p.y - cy + r];
+    row->x0 = std::min(row->x0, (int)p.x);
+    row->x1 = std::max(row->x1, (int)p.x);
+  }
+  int bad = 0;
+  for (int dy = -r; dy <= r; dy++) {
+    Span s = spans[first + dy + r];
+    if (s.y != cy + dy || s.x0 != rows[dy + r].x0 || s.x1 != rows[dy + r].x1) bad++;
+  }
+  return bad;
+}
+
+// span ends within a pixel of the exact ellipse, along x or along y where
+// the outline is flat
+int check_ellipse(const std::vector<Span> &spans, uint32_t first, int cx, int cy, int rx, int ry) {
+  int bad = 0;
+  for (int dy = -ry; dy <= ry; dy++) {
+    Span s = spans[first + dy + ry];
+    int half = s.x1 - cx;
+    float ty = (float)dy / std::max(ry, 1), tx = (float)half / std::max(rx, 1);
+    float dx_err = fabsf(half - rx * sqrtf(std::max(0.0f, 1.0f - ty * ty)));
+    float dy_err = fabsf(abs(dy) - ry * sqrtf(std::max(0.0f, 1.0f - tx * tx)));
+    if (s.y != cy + dy || half != cx - s.x0 || std::min(dx_err, dy_err) > 1.0f) bad++;
+  }
+  return bad;
+}
+
+int bench_spans(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> px(0, WIDTH - 1), py(0, HEIGHT - 1), radius(0, 300);
+  std::vector<int> shapes(4 * count);
+  for (uint32_t i = 0; i < count; i++) {
+    shapes[4 * i] = px(rng);
+    shapes[4 * i + 1] = py(rng);
+    shapes[4 * i + 2] = radius(rng);
+    shapes[4 * i + 3] = radius(rng);
+  }
+
+  uint32_t mismatches = 0;
+  std::vector<Span> spans;
+  for (uint32_t i = 0; i < std::min(count, 10000u); i++) {
+    const int *s = &shapes[4 * i];
+    spans.clear();
+    disk_spans(s[0], s[1], s[2], &spans);
+    mismatches += check_disk(spans, 0, s[0], s[1], s[2]) != 0;
+    spans.clear();
+    ellipse_spans(s[0], s[1], s[2], s[3], &spans);
+    mismatches += check_ellipse(spans, 0, s[0], s[1], s[2], s[3]) != 0;
+  }
+
+  uint64_t disk_count = 0, ellipse_count = 0, area = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; i++) {
+    spans.clear();
+    disk_count += disk_spans(shapes[4 * i], shapes[4 * i + 1], shapes[4 * i + 2], &spans);
+    for (Span s : spans) area += s.x1 - s.x0 + 1;
+  }
+  double disk_ms = elapsed_ms(start);
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < count; i++) {
+    spans.clear();
+    ellipse_count += ellipse_spans(shapes[4 * i], shapes[4 * i + 1], shapes[4 * i + 2], shapes[4 * i + 3], &spans);
+  }
+  double ellipse_ms = elapsed_ms(start);
+
+  // the radius 150 disk drawn by the loop
+  Circle c;
+  circle_init(&c, 6 * 301);
+  disk_spans(WIDTH / 2, HEIGHT / 2, 150, &c.spans);
+  uint32_t points = 0;
+  for (Span s : c.spans) points += s.x1 - s.x0 + 1;
+  uint32_t quad_vertices = put_spans(&c);
+
+  std::cout << "disks: " << disk_count / disk_ms / 1000.0 << " Mspans/s, " << area / disk_ms / 1000.0 << " Mpixels/s filled" << std::endl;
+  std::cout << "ellipses: " << ellipse_count / ellipse_ms / 1000.0 << " Mspans/s" << std::endl;
+  std::cout << "radius 150 disk: " << c.spans.size() << " spans, " << quad_vertices << " quad vertices, " << points << " pixels as points ("
+            << quad_vertices * sizeof(Pixel) << " vs " << points * sizeof(Pixel) << " bytes)" << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+// many outlines per frame into one stream reserved up front
+int bench_circles(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> px(0, WIDTH - 1), py(0, HEIGHT - 1), radius(1, 150);
+  std::vector<int> circles(3 * count);
+  uint64_t capacity = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    circles[3 * i] = px(rng);
+    circles[3 * i + 1] = py(rng);
+    circles[3 * i + 2] = radius(rng);
+    capacity += 8 * (circles[3 * i + 2] + 1);
+  }
+
+  Circle c;
+  circle_init(&c, capacity);
+  const Pixel *data = c.pixels.data();
+  const uint32_t frames = 10;
+  uint64_t pixels = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t f = 0; f < frames; f++) {
+    c.pixels.clear();
+    pixels = 0;
+    for (uint32_t i = 0; i < count; i++) pixels += midpointCircle(&c, circles[3 * i], circles[3 * i + 1], circles[3 * i + 2]);
+  }
+  double ms = elapsed_ms(start);
+
+  // a glm::vec4 position and color, two ints and an index per pixel before
+  uint64_t old_bytes = pixels * (2 * sizeof(glm::vec4) + 2 * sizeof(int) + sizeof(uint32_t));
+  uint64_t upload_bytes = pixels * sizeof(Pixel);
+  std::cout << "circles: " << count << ", pixels per frame: " << pixels << std::endl;
+  std::cout << "rasterize: " << ms / frames << " ms per frame, " << frames * pixels / ms / 1000.0 << " Mpixels/s" << std::endl;
+  std::cout << "stream: " << upload_bytes / 1024 << " KiB per frame, was " << old_bytes / 1024 << " KiB ("
+            << (double)old_bytes / upload_bytes << "x)" << std::endl;
+  std::cout << "reallocations: " << (c.pixels.data() != data) << std::endl;
+  return c.pixels.data() == data ? 0 : 1;
+}
+
+bool pixel_less(Pixel a, Pixel b) {
+  return a.y != b.y ? a.y < b.y : a.x < b.x;
+}
+
+int bench_midpoint(int max_radius) {
+  struct { const char *name; CircleFn fn; bool supported; } kernels[] = {
+    { "scalar", midpoint_circle_pixels, true },
+#if defined(__x86_64__) || defined(__i386__)
+    { "avx2", circle_avx2, (bool)__builtin_cpu_supports("avx2") },
+#endif
+  };
+
+  // same pixels as the incremental walk for every radius
+  uint32_t mismatches = 0;
+  std::vector<Pixel> a(midpoint_circle_count(std::max(max_radius, 10000))), b(a.size());
+  for (int r = 0; r <= max_radius; r++) {
+    uint32_t n = midpoint_circle_pixels(640, 450, r, a.data());
+    std::sort(a.begin(), a.begin() + n, pixel_less);
+    if (n != midpoint_circle_count(r)) mismatches++;
+    for (auto &k : kernels) {
+      if (!k.supported) continue;
+      if (k.fn(640, 450, r, b.data()) != n) {
+        mismatches++;
+        continue;
+      }
+      std::sort(b.begin(), b.begin() + n, pixel_less);
+      if (memcmp(a.data(), b.data(), n * sizeof(Pixel)) != 0) mismatches++;
+    }
+  }
+
+  int radii[] = { 16, 150, 1000, 10000 };
+  for (int r : radii) {
+    uint32_t n = midpoint_circle_count(r);
+    uint32_t rounds = std::max(1u, 20000000u / n);
+    Circle c;
+    circle_init(&c, n);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rounds; i++) {
+      c.pixels.clear();
+      plot_midpoint_circle(&c, 640, 450, r);
+    }
+    double base_ms = elapsed_ms(start);
+    std::cout << "radius " << r << ", " << n << " pixels: add_pixel " << (double)n * rounds / base_ms / 1000.0 << " Mpixels/s";
+    for (auto &k : kernels) {
+      if (!k.supported) continue;
+      start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < rounds; i++) k.fn(640, 450, r, a.data());
+      double ms = elapsed_ms(start);
+      std::cout << ", " << k.name << " " << base_ms / ms << "x";
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+int bench_wu(uint32_t count) {
+  struct { const char *name; WuLineFn line; WuCircleFn circle; bool supported; } kernels[] = {
+    { "scalar", wu_line_scalar, wu_circle_scalar, true },
+#if defined(__x86_64__) || defined(__i386__)
+    { "avx2", wu_line_avx2, wu_circle_avx2, (bool)__builtin_cpu_supports("avx2") },
+#endif
+  };
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coord(0.0f, 1279.0f);
+  std::vector<float> segments(4 * count);
+  uint32_t max_count = 0;
+  uint64_t pixels = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    float *s = &segments[4 * i];
+    for (int k = 0; k < 4; k++) s[k] = coord(rng);
+    max_count = std::max(max_count, wu_line_count(s[0], s[1], s[2], s[3]));
+    pixels += wu_line_count(s[0], s[1], s[2], s[3]);
+  }
+
+  // the same pixels and coverage as the scalar kernels, the pixels of a
+  // step covering it once
+  uint32_t mismatches = 0, uneven = 0;
+  float max_radius = 2000.5f;
+  std::vector<Pixel> a(std::max(max_count, wu_circle_count(max_radius)) + WU_LANES), b(a.size());
+  std::vector<uint8_t> ca(a.size()), cb(a.size());
+  for (uint32_t i = 0; i < std::min(count, 100000u); i++) {
+    const float *s = &segments[4 * i];
+    uint32_t n = wu_line_scalar(s[0], s[1], s[2], s[3], a.data(), ca.data());
+    if (n != wu_line_count(s[0], s[1], s[2], s[3])) mismatches++;
+    for (uint32_t j = 2; j + 2 < n; j += 2) {
+      if (abs(ca[j] + ca[j + 1] - 255) > 1) uneven++;
+    }
+    for (auto &k : kernels) {
+      if (!k.supported || k.line == wu_line_scalar) continue;
+      if (k.line(s[0], s[1], s[2], s[3], b.data(), cb.data()) != n ||
+	  memcmp(a.data(), b.data(), n * sizeof(Pixel)) != 0 || memcmp(ca.data(), cb.data(), n) != 0) mismatches++;
+    }
+  }
+  // circles are octant-major per chunk, compared as sorted (pixel, coverage)
+  // pairs. A pixel emitted twice would be blended twice
+  uint32_t duplicates = 0;
+  auto sorted_pairs = [](const Pixel *p, const uint8_t *c, uint32_t n, std::vector<std::pair<uint32_t, uint8_t>> *out) {
+    out->resize(n);
+    for (uint32_t j = 0; j < n; j++) (*out)[j] = { (uint32_t)(uint16_t)p[j].x << 16 | (uint16_t)p[j].y, c[j] };
+    std::sort(out->begin(), out->end());
+  };
+  std::vector<std::pair<uint32_t, uint8_t>> pa, pb;
+  for (float r = 0.0f; r <= max_radius; r += 0.75f) {
+    uint32_t n = wu_circle_scalar(640, 450, r, a.data(), ca.data());
+    if (n != wu_circle_count(r)) mismatches++;
+    sorted_pairs(a.data(), ca.data(), n, &pa);
+    for (uint32_t j = 1; j < n; j++) duplicates += pa[j].first == pa[j - 1].first;
+    // near and far pixel of every step of the first octant
+    for (int x = 0; x <= wu_circle_last(r); x++) {
+      int y = (int)floorf(wu_circle_y(r, x));
+      uint32_t near = (uint32_t)(uint16_t)(640 + x) << 16 | (uint16_t)(450 + y);
+      auto at = std::lower_bound(pa.begin(), pa.end(), std::make_pair(near, (uint8_t)0));
+      if (at + 1 >= pa.end() || at->first != near || (at + 1)->first != near + 1 || abs(at->second + (at + 1)->second - 255) > 1) uneven++;
+    }
+    for (auto &k : kernels) {
+      if (!k.supported || k.circle == wu_circle_scalar) continue;
+      if (k.circle(640, 450, r, b.data(), cb.data()) != n) {
+	mismatches++;
+	continue;
+      }
+      sorted_pairs(b.data(), cb.data(), n, &pb);
+      if (pa != pb) mismatches++;
+    }
+  }
+
+  std::vector<int> int_segments(segments.begin(), segments.end());
+  auto start = std::chrono::steady_clock::now();
+  uint64_t checksum = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const int *s = &int_segments[4 * i];
+    checksum += bresenham_pixels(s[0], s[1], s[2], s[3], a.data());
+  }
+  double bresenham_ms = elapsed_ms(start);
+  std::cout << "bresenham: " << checksum / bresenham_ms / 1000.0 << " Mpixels/s" << std::endl;
+  for (auto &k : kernels) {
+    if (!k.supported) continue;
+    start = std::chrono::steady_clock::now();
+    checksum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      const float *s = &segments[4 * i];
+      checksum += k.line(s[0], s[1], s[2], s[3], a.data(), ca.data());
+    }
+    double ms = elapsed_ms(start);
+    std::cout << "wu line " << k.name << ": " << checksum / ms / 1000.0 << " Mpixels/s, " << bresenham_ms / ms << "x bresenham" << std::endl;
+  }
+
+  int radii[] = { 150, 1000 };
+  for (int r : radii) {
+    uint32_t rounds = std::max(1u, 20000000u / wu_circle_count(r));
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < rounds; i++) midpoint_circle_pixels(640, 450, r, a.data());
+    double base_ms = elapsed_ms(start);
+    std::cout << "radius " << r << ": midpoint " << (double)midpoint_circle_count(r) * rounds / base_ms / 1000.0 << " Mpixels/s";
+    for (auto &k : kernels) {
+      if (!k.supported) continue;
+      start = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < rounds; i++) k.circle(640, 450, r + 0.5f, a.data(), ca.data());
+      double ms = elapsed_ms(start);
+      std::cout << ", wu " << k.name << " " << (double)wu_circle_count(r + 0.5f) * rounds / ms / 1000.0 << " Mpixels/s";
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << "segments: " << count << ", pixels: " << pixels << std::endl;
+  std::cout << "mismatches: " << mismatches << ", uneven coverage: " << uneven << ", duplicate circle pixels: " << duplicates << std::endl;
+  return mismatches == 0 && uneven == 0 && duplicates == 0 ? 0 : 1;
+}
+
+int bench_batch(uint32_t count, uint32_t threads) {
+  std::mt19937 rng(42);
+  CircleBatch batch;
+  random_batch(&rng, count, &batch.circles);
+
+  circle_batch_rasterize(&batch, threads);
+  uint32_t mismatches = 0;
+  Circle reference;
+  circle_init(&reference, 8 * (150 + 1));
+  for (uint32_t i = 0; i < count; i++) {
+    BatchCircle c = batch.circles[i];
+    reference.pixels.clear();
+    uint32_t n = midpointCircle(&reference, c.x, c.y, c.radius);
+    uint32_t first = batch.offsets[i];
+    if (batch.offsets[i + 1] - first != n || memcmp(&batch.pixels[first], reference.pixels.data(), n * sizeof(Pixel)) != 0) mismatches++;
+    if (batch.colors[first] != pack_color(c.color) || batch.colors[first + n - 1] != pack_color(c.color)) mismatches++;
+  }
+
+  const uint32_t frames = 20;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t f = 0; f < frames; f++) circle_batch_rasterize(&batch, threads);
+  double ms = elapsed_ms(start) / frames;
+
+  std::cout << "circles: " << count << ", threads: " << threads << ", pixels: " << batch.count << std::endl;
+  std::cout << "rasterize: " << ms << " ms per frame (" << 1000.0 / ms << " fps), upload "
+            << batch.count * (sizeof(Pixel) + sizeof(uint32_t)) / 1024 << " KiB in one draw call" << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+// draws the same batch as points and as analytic quads into an offscreen
+// framebuffer and diffs them, needs the gl context from main
+int compare_gpu(uint32_t count) {
+  uint32_t point_program, circle_program;
+  if (compile_shaders(&point_program) != 0) return 1;
+  if (compile_program(circle_vertex_shader_source, circle_fragment_shader_source, &circle_program) != 0) return 1;
+  Uniforms point_uniforms = get_uniforms(point_program);
+  Uniforms circle_uniforms = get_uniforms(circle_program);
+
+  uint32_t FBO, RBO;
+  glGenFramebuffers(1, &FBO);
+  glGenRenderbuffers(1, &RBO);
+  glBindRenderbuffer(GL_RENDERBUFFER, RBO);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, RBO);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Could not create the offscreen framebuffer!" << std::endl;
+    return 1;
+  }
+  glViewport(0, 0, WIDTH, HEIGHT);
+  glDisable(GL_BLEND);
+  glVertexAttrib4f(1, 1.0f, 1.0f, 1.0f, 1.0f);
+  glVertexAttrib1f(2, 1.0f);
+
+  std::mt19937 rng(42);
+  CircleBatch batch;
+  random_batch(&rng, count, &batch.circles);
+  // the edges of the walk
+  int radii[] = { 0, 1, 2, 255, 256, 257, 300 };
+  for (int r : radii) batch.circles.push_back((BatchCircle){ .x = 640, .y = 450, .radius = r, .color = glm::vec4(1.0f) });
+
+  BatchBuffers batch_buffers;
+  batch_buffers_init(&batch_buffers);
+  InstanceBuffers instance_buffers;
+  instance_buffers_init(&instance_buffers);
+  std::vector<CircleInstance> instances;
+  std::vector<uint8_t> points(WIDTH * HEIGHT * 4), analytic(WIDTH * HEIGHT * 4);
+  glm::vec3 translate = glm::vec3(0.0f), scale = glm::vec3(1.0f);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+  auto start = std::chrono::steady_clock::now();
+  circle_batch_rasterize(&batch, std::thread::hardware_concurrency());
+  batch_upload(&batch_buffers, batch);
+  glUseProgram(point_program);
+  draw_batch(batch_buffers, point_uniforms, batch, translate, scale, 1.0f);
+  glFinish();
+  double points_ms = elapsed_ms(start);
+  glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, points.data());
+
+  glClear(GL_COLOR_BUFFER_BIT);
+  start = std::chrono::steady_clock::now();
+  circle_instances(batch, &instances);
+  instance_upload(&instance_buffers, instances);
+  glUseProgram(circle_program);
+  draw_instances(instance_buffers, circle_uniforms, instances.size(), translate, scale);
+  glFinish();
+  double analytic_ms = elapsed_ms(start);
+  glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, analytic.data());
+
+  uint32_t mismatches = 0, covered = 0;
+  for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) {
+    if (memcmp(&points[4 * i], &analytic[4 * i], 4) != 0) mismatches++;
+    if (points[4 * i + 3] != 0) covered++;
+  }
+
+  std::cout << "circles: " << batch.circles.size() << ", covered pixels: " << covered << std::endl;
+  std::cout << "points: " << batch.count * (sizeof(Pixel) + sizeof(uint32_t)) << " bytes uploaded, " << points_ms << " ms" << std::endl;
+  std::cout << "analytic: " << instances.size() * sizeof(CircleInstance) << " bytes uploaded, " << analytic_ms << " ms" << std::endl;
+  std::cout << "mismatched pixels: " << mismatches << std::endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return mismatches == 0 ? 0 : 1;
+}
 
 void loop(GLFWwindow *window) {
 
@@ -282,29 +1778,56 @@ void loop(GLFWwindow *window) {
   uint32_t program;
   int error = compile_shaders(&program);
   if (error != 0) exit(1);
+  Uniforms uniforms = get_uniforms(program);
+  uint32_t circle_program;
+  error = compile_program(circle_vertex_shader_source, circle_fragment_shader_source, &circle_program);
+  if (error != 0) exit(1);
+  Uniforms circle_uniforms = get_uniforms(circle_program);
   
-  Vertex vertices[MAX_VERTEX_COUNT];
-  uint32_t idx = 0;
+  std::mt19937 rng(42);
+  CircleBatch batch;
+  BatchBuffers batch_buffers;
+  batch_buffers_init(&batch_buffers);
+  bool batch_dirty = false;
+  bool analytic = false; // batch as instanced quads instead of points
+  InstanceBuffers instance_buffers;
+  instance_buffers_init(&instance_buffers);
+  std::vector<CircleInstance> instances;
+  uint32_t threads = std::thread::hardware_concurrency();
+
   Circle circle;
+  circle_init(&circle, MAX_PIXELS);
+  bool dirty = false;
+  uint32_t uploaded = 0; // pixels already in the VBO, the stream is appended to
+  uint32_t shape = 0; // outline, disk, ellipse
+  bool smooth = false; // Wu outlines joined by Wu lines
+  bool has_last = false;
+  glm::vec2 last_click;
 
   glm::vec3 translate = glm::vec3(0.0f, 0.f, 0.f);
-  uint32_t VAO, VBO;
+  uint32_t VAO, VBO, coverage_VBO;
 
   glGenVertexArrays(1, &VAO);
   glGenBuffers(1, &VBO);
+  glGenBuffers(1, &coverage_VBO);
 
   glBindVertexArray(VAO);
   
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, MAX_PIXELS * sizeof(Pixel), nullptr, GL_DYNAMIC_DRAW);
   
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+  glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(Pixel), (void*)offsetof(Pixel, x));
   glEnableVertexAttribArray(0); // location 0
 
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
-  glEnableVertexAttribArray(1); // location 1
+  // enabled by draw_triangles when the pixels carry coverage
+  glBindBuffer(GL_ARRAY_BUFFER, coverage_VBO);
+  glBufferData(GL_ARRAY_BUFFER, MAX_PIXELS * sizeof(uint8_t), nullptr, GL_DYNAMIC_DRAW);
+  glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(uint8_t), (void*)0);
 
   glBindBuffer(GL_ARRAY_BUFFER, 0); 
+  // pixel colors and coverage for draws without their arrays
+  glVertexAttrib4f(1, 1.0f, 1.0f, 1.0f, 1.0f);
+  glVertexAttrib1f(2, 1.0f);
 
   float start_time = glfwGetTime();
   float delta = 0.0f;
@@ -350,7 +1873,34 @@ void loop(GLFWwindow *window) {
     } else if (is_key_pressed(window, GLFW_KEY_1)) {
       if (start_time - click_time > threshold) {
 	click_time = start_time;
-      
+	shape = (shape + 1) % 3;
+	std::cout << "shape: " << (shape == 0 ? "outline" : shape == 1 ? "disk" : "ellipse") << std::endl;
+      }
+    } else if (is_key_pressed(window, GLFW_KEY_2)) {
+      if (start_time - click_time > threshold) {
+	click_time = start_time;
+	random_batch(&rng, 10000, &batch.circles);
+	batch_dirty = true;
+      }
+    } else if (is_key_pressed(window, GLFW_KEY_3)) {
+      if (start_time - click_time > threshold) {
+	click_time = start_time;
+	batch.circles.clear();
+	batch_dirty = true;
+      }
+    } else if (is_key_pressed(window, GLFW_KEY_4)) {
+      if (start_time - click_time > threshold) {
+	click_time = start_time;
+	analytic = !analytic;
+	batch_dirty = true;
+	std::cout << "batch: " << (analytic ? "analytic" : "points") << std::endl;
+      }
+    } else if (is_key_pressed(window, GLFW_KEY_5)) {
+      if (start_time - click_time > threshold) {
+	click_time = start_time;
+	smooth = !smooth;
+	has_last = false;
+	std::cout << "outline: " << (smooth ? "anti-aliased" : "aliased") << std::endl;
       }
     }
 
@@ -383,11 +1933,34 @@ void loop(GLFWwindow *window) {
 	glm::vec4 position = glm::vec4((float)point.x, (float)point.y, 0.0f, 1.0f);
 	glm::vec4 color = glm::vec4(1.0 * (mouse_pos.x/1000.0f), 1.0 * (mouse_pos.y/1000.0f), 1.0 * (((mouse_pos.x + mouse_pos.y) / 2) / 1000.0f), 1.f);
 
-	idx = 0;
-	circle.idxs.clear();
-	circle.pixels.clear();
-	circle.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-	idx = midpointCircle(vertices, idx, &circle, (int)mouse_pos.x, (int)mouse_pos.y, 150);
+	if (shape == 0 && smooth) {
+	  if (circle.primitive != GL_POINTS) {
+	    circle.pixels.clear();
+	    circle.coverage.clear();
+	    uploaded = 0;
+	  }
+	  circle.color = glm::vec4(1.0f);
+	  circle.primitive = GL_POINTS;
+	  wu_circle(&circle, (int)mouse_pos.x, (int)mouse_pos.y, 150.5f);
+	  if (has_last) wu_line(&circle, last_click.x, last_click.y, (float)mouse_pos.x, (float)mouse_pos.y);
+	  last_click = glm::vec2((float)mouse_pos.x, (float)mouse_pos.y);
+	  has_last = true;
+	  dirty = true;
+	} else if (shape == 0) {
+	  batch.circles.push_back((BatchCircle){ .x = (int)mouse_pos.x, .y = (int)mouse_pos.y, .radius = 150, .color = color });
+	  batch_dirty = true;
+	} else {
+	  circle.pixels.clear();
+	  circle.coverage.clear();
+	  circle.spans.clear();
+	  uploaded = 0;
+	  circle.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	  circle.primitive = GL_TRIANGLES;
+	  if (shape == 1) disk_spans((int)mouse_pos.x, (int)mouse_pos.y, 150, &circle.spans);
+	  else ellipse_spans((int)mouse_pos.x, (int)mouse_pos.y, 200, 100, &circle.spans);
+	  put_spans(&circle);
+	  dirty = true;
+	}
 
       }
     }
@@ -401,16 +1974,47 @@ void loop(GLFWwindow *window) {
       }
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+    if (dirty) {
+      uint32_t n = circle.pixels.size() - uploaded;
+      // nothing new when the stream was full, pixels[uploaded] is past the end
+      if (n) {
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, uploaded * sizeof(Pixel), n * sizeof(Pixel), &circle.pixels[uploaded]);
+	if (!circle.coverage.empty()) {
+	  glBindBuffer(GL_ARRAY_BUFFER, coverage_VBO);
+	  glBufferSubData(GL_ARRAY_BUFFER, uploaded, n, &circle.coverage[uploaded]);
+	}
+      }
+      std::cout << "pixels: " << circle.pixels.size() << ", " << n * (sizeof(Pixel) + (circle.coverage.empty() ? 0 : 1)) << " bytes uploaded" << std::endl;
+      uploaded = circle.pixels.size();
+      dirty = false;
+    }
+    if (batch_dirty && analytic) {
+      circle_instances(batch, &instances);
+      instance_upload(&instance_buffers, instances);
+      std::cout << "batch: " << instances.size() << " circles, " << instances.size() * sizeof(CircleInstance) << " bytes uploaded" << std::endl;
+      batch_dirty = false;
+    } else if (batch_dirty) {
+      auto raster_start = std::chrono::steady_clock::now();
+      circle_batch_rasterize(&batch, threads);
+      batch_upload(&batch_buffers, batch);
+      std::cout << "batch: " << batch.circles.size() << " circles, " << batch.count << " pixels, "
+		<< batch.count * (sizeof(Pixel) + sizeof(uint32_t)) << " bytes uploaded, " << elapsed_ms(raster_start) << " ms" << std::endl;
+      batch_dirty = false;
+    }
     
     glUseProgram(program);
 
     //glBindVertexArray(VAO);
-    draw_triangles(VAO, program, circle);
+    draw_triangles(VAO, uniforms, circle);
+    if (analytic) {
+      glUseProgram(circle_program);
+      draw_instances(instance_buffers, circle_uniforms, instances.size(), translate, scale);
+    } else {
+      draw_batch(batch_buffers, uniforms, batch, translate, scale, 2.0f);
+    }
     
     //std::cout << "total clicks: " << total_click << std::endl;
-    std::cout << "total vertices: " << idx << std::endl;
     //print_circle(circle);
     //std::cout << "total polys: " << polys.size() << std::endl;
     
@@ -420,9 +2024,19 @@ void loop(GLFWwindow *window) {
   glfwDestroyCursor(cursor);
 }
 
-int main(void) {
+int main(int argc, char **argv) {
   std::cout << "hello, world!" << std::endl;
 
+  if (argc > 1 && strcmp(argv[1], "bench-lines") == 0) return bench_lines(argc > 2 ? atoi(argv[2]) : 2000000);
+  if (argc > 1 && strcmp(argv[1], "bench-wu") == 0) return bench_wu(argc > 2 ? atoi(argv[2]) : 1000000);
+  if (argc > 1 && strcmp(argv[1], "bench-midpoint") == 0) return bench_midpoint(argc > 2 ? atoi(argv[2]) : 2000);
+  if (argc > 1 && strcmp(argv[1], "bench-batch") == 0) {
+    uint32_t count = argc > 2 ? atoi(argv[2]) : 10000;
+    return bench_batch(count, argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency());
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-circles") == 0) return bench_circles(argc > 2 ? atoi(argv[2]) : 10000);
+  if (argc > 1 && strcmp(argv[1], "bench-spans") == 0) return bench_spans(argc > 2 ? atoi(argv[2]) : 100000);
+
   if (!glfwInit()) {
     std::cerr << "Could not initialize glfw!" << std::endl;
     std::cerr << "error: " << strerror(errno) << std::endl;
@@ -437,6 +2051,9 @@ int main(void) {
   glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 
+  bool compare = argc > 1 && strcmp(argv[1], "compare-gpu") == 0;
+  if (compare) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
   const char *title = "main.cpp - pizza";
 
   GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, title, nullptr, nullptr);
@@ -460,6 +2077,12 @@ int main(void) {
   std::cout << glGetString(GL_RENDERER) << std::endl;
   std::cout << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
   
+  if (compare) {
+    int result = compare_gpu(argc > 2 ? atoi(argv[2]) : 1000);
+    glfwTerminate();
+    return result;
+  }
+
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   
@@ -5,6 +5,16 @@
 #include <errno.h>
 #include <chrono>
 #include <thread>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <mutex>
+#include <deque>
+#include <functional>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -190,7 +200,15 @@ bool pointInTriangle(const glm::vec3& P,
     return (u >= 0) && (v >= 0) && (w >= 0);
 }
 
-bool check_p_in_triangle(glm::vec3 P, glm::vec3 A, glm::vec3 B, glm::vec3 C) {
+// Hit record shared by the intersection routines, P = w * A + u * B + v * C
+typedef struct {
+  float t;           // ray parameter, P = orig + t * dir
+  float u, v, w;     // barycentric weights of B, C and A
+  glm::vec3 point;
+  uint32_t triangle; // index into triangles[], set by the BVH
+} Hit;
+
+bool check_p_in_triangle(glm::vec3 P, glm::vec3 A, glm::vec3 B, glm::vec3 C, Hit *hit) {
   glm::vec3 v0 = B - A;
   glm::vec3 v1 = C - A;
   glm::vec3 v2 = P - A;
@@ -208,11 +226,23 @@ bool check_p_in_triangle(glm::vec3 P, glm::vec3 A, glm::vec3 B, glm::vec3 C) {
   float w = (d00 * d21 - d01 * d20) / denom;
   float u = 1.0f - v - w;
 
-  return (u >= 0) && (v >= 0) && (w >= 0);
+  if ((u >= 0) && (v >= 0) && (w >= 0)) {
+    hit->u = v;
+    hit->v = w;
+    hit->w = u;
+    hit->point = P;
+    return true;
+  }
+  return false;
 }
 
+bool check_p_in_triangle(glm::vec3 P, glm::vec3 A, glm::vec3 B, glm::vec3 C) {
+  Hit hit;
+  return check_p_in_triangle(P, A, B, C, &hit);
+}
 
-bool intersect_ray_triangle(glm::vec3 P0, glm::vec3 P1, glm::vec3 A, glm::vec3 B, glm::vec3 C) {
+// segment P0 -> P1, t in [0, 1]
+bool intersect_ray_triangle(glm::vec3 P0, glm::vec3 P1, glm::vec3 A, glm::vec3 B, glm::vec3 C, Hit *hit) {
   glm::vec3 dir = P1 - P0;
 
   glm::vec3 edge1 = B - A;
@@ -239,13 +269,17 @@ bool intersect_ray_triangle(glm::vec3 P0, glm::vec3 P1, glm::vec3 A, glm::vec3 B
 
   glm::vec3 P = P0 + t * dir;
 
-  return check_p_in_triangle(P, A, B, C);
+  if (!check_p_in_triangle(P, A, B, C, hit)) return false;
+  hit->t = t;
+  return true;
 }
 
-bool MollerTrumbore(glm::vec3 orig, glm::vec3 dir, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
-  glm::vec3 edge1 = v1 - v0;
-  glm::vec3 edge2 = v2 - v0;
+bool intersect_ray_triangle(glm::vec3 P0, glm::vec3 P1, glm::vec3 A, glm::vec3 B, glm::vec3 C) {
+  Hit hit;
+  return intersect_ray_triangle(P0, P1, A, B, C, &hit);
+}
 
+bool moller_trumbore_edges(glm::vec3 orig, glm::vec3 dir, glm::vec3 v0, glm::vec3 edge1, glm::vec3 edge2, Hit *hit) {
   glm::vec3 h = glm::cross(dir, edge2);
   float a = glm::dot(edge1, h);
   if (glm::abs(a) < 1e-6f)
@@ -264,25 +298,578 @@ bool MollerTrumbore(glm::vec3 orig, glm::vec3 dir, glm::vec3 v0, glm::vec3 v1, g
 
   float t = f * glm::dot(edge2, q);
   if (t > 1e-6f) {
-    glm::vec3 intersection = orig + t * dir;
+    hit->t = t;
+    hit->u = u;
+    hit->v = v;
+    hit->w = 1.0f - u - v;
+    hit->point = orig + t * dir;
     return true;
   }
 
   return false;
 }
 
-void draw_triangles(uint32_t VAO, uint32_t program, Vertex *vertices, uint32_t tidx, Triangle triangles[MAX_TRIANGLES], Ray ray) {
-  int v_transform = glGetUniformLocation(program, "v_transform");
-  Triangle triangle = triangles[0];
+bool MollerTrumbore(glm::vec3 orig, glm::vec3 dir, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, Hit *hit) {
+  return moller_trumbore_edges(orig, dir, v0, v1 - v0, v2 - v0, hit);
+}
+
+bool MollerTrumbore(glm::vec3 orig, glm::vec3 dir, glm::vec3 v0, glm::vec3 v1, glm::vec3 v2) {
+  Hit hit;
+  return MollerTrumbore(orig, dir, v0, v1, v2, &hit);
+}
+
+// Packet kernels: one ray against PACKET_WIDTH triangles stored SoA. The
+// widest kernel the cpu supports is picked at startup, lanes that are not
+// used hold degenerate triangles and never hit. Only used by bench-packet:
+// SAH leaves of the BVH below hold under 2 triangles on average, a packet
+// per leaf would leave most lanes empty.
+
+#define PACKET_WIDTH 8
+
+typedef struct {
+  float v0x[PACKET_WIDTH], v0y[PACKET_WIDTH], v0z[PACKET_WIDTH];
+  float e1x[PACKET_WIDTH], e1y[PACKET_WIDTH], e1z[PACKET_WIDTH];
+  float e2x[PACKET_WIDTH], e2y[PACKET_WIDTH], e2z[PACKET_WIDTH];
+} TrianglePacket;
+
+typedef struct {
+  uint32_t mask; // bit i set when lane i was hit
+  float t[PACKET_WIDTH], u[PACKET_WIDTH], v[PACKET_WIDTH];
+} PacketHit;
+
+typedef void (*IntersectPacketFn)(glm::vec3 orig, glm::vec3 dir, const TrianglePacket *p, PacketHit *out);
+
+// positions holds v0 v1 v2 of every triangle
+void triangle_packets_build(const glm::vec3 *positions, uint32_t count, std::vector<TrianglePacket> *packets) {
+  packets->assign((count + PACKET_WIDTH - 1) / PACKET_WIDTH, TrianglePacket{});
+  for (uint32_t i = 0; i < count; i++) {
+    TrianglePacket *p = &(*packets)[i / PACKET_WIDTH];
+    uint32_t lane = i % PACKET_WIDTH;
+    glm::vec3 v0 = positions[i * 3];
+    glm::vec3 e1 = positions[i * 3 + 1] - v0;
+    glm::vec3 e2 = positions[i * 3 + 2] - v0;
+    p->v0x[lane] = v0.x; p->v0y[lane] = v0.y; p->v0z[lane] = v0.z;
+    p->e1x[lane] = e1.x; p->e1y[lane] = e1.y; p->e1z[lane] = e1.z;
+    p->e2x[lane] = e2.x; p->e2y[lane] = e2.y; p->e2z[lane] = e2.z;
+  }
+}
+
+void intersect_packet_scalar(glm::vec3 orig, glm::vec3 dir, const TrianglePacket *p, PacketHit *out) {
+  out->mask = 0;
+  for (uint32_t i = 0; i < PACKET_WIDTH; i++) {
+    glm::vec3 v0 = glm::vec3(p->v0x[i], p->v0y[i], p->v0z[i]);
+    glm::vec3 v1 = v0 + glm::vec3(p->e1x[i], p->e1y[i], p->e1z[i]);
+    glm::vec3 v2 = v0 + glm::vec3(p->e2x[i], p->e2y[i], p->e2z[i]);
+    Hit hit;
+    if (MollerTrumbore(orig, dir, v0, v1, v2, &hit)) {
+      out->t[i] = hit.t;
+      out->u[i] = hit.u;
+      out->v[i] = hit.v;
+      out->mask |= 1u << i;
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+void intersect_packet_sse(glm::vec3 orig, glm::vec3 dir, const TrianglePacket *p, PacketHit *out) {
+  __m128 eps = _mm_set1_ps(1e-6f);
+  __m128 zero = _mm_setzero_ps();
+  __m128 one = _mm_set1_ps(1.0f);
+  __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 dx = _mm_set1_ps(dir.x), dy = _mm_set1_ps(dir.y), dz = _mm_set1_ps(dir.z);
+  __m128 ox = _mm_set1_ps(orig.x), oy = _mm_set1_ps(orig.y), oz = _mm_set1_ps(orig.z);
+  out->mask = 0;
+
+  for (uint32_t i = 0; i < PACKET_WIDTH; i += 4) {
+    __m128 e1x = _mm_loadu_ps(p->e1x + i), e1y = _mm_loadu_ps(p->e1y + i), e1z = _mm_loadu_ps(p->e1z + i);
+    __m128 e2x = _mm_loadu_ps(p->e2x + i), e2y = _mm_loadu_ps(p->e2y + i), e2z = _mm_loadu_ps(p->e2z + i);
+
+    // h = dir x edge2
+    __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+    __m128 f = _mm_div_ps(one, a);
+
+    __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(p->v0x + i));
+    __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(p->v0y + i));
+    __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(p->v0z + i));
+    __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+    // q = s x edge1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+    __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+    __m128 hit = _mm_cmpge_ps(_mm_and_ps(a, abs_mask), eps);
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+    hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, eps));
+
+    _mm_storeu_ps(out->t + i, t);
+    _mm_storeu_ps(out->u + i, u);
+    _mm_storeu_ps(out->v + i, v);
+    out->mask |= (uint32_t)_mm_movemask_ps(hit) << i;
+  }
+}
+
+__attribute__((target("avx2")))
+void intersect_packet_avx2(glm::vec3 orig, glm::vec3 dir, const TrianglePacket *p, PacketHit *out) {
+  __m256 eps = _mm256_set1_ps(1e-6f);
+  __m256 zero = _mm256_setzero_ps();
+  __m256 one = _mm256_set1_ps(1.0f);
+  __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 dx = _mm256_set1_ps(dir.x), dy = _mm256_set1_ps(dir.y), dz = _mm256_set1_ps(dir.z);
+
+  __m256 e1x = _mm256_loadu_ps(p->e1x), e1y = _mm256_loadu_ps(p->e1y), e1z = _mm256_loadu_ps(p->e1z);
+  __m256 e2x = _mm256_loadu_ps(p->e2x), e2y = _mm256_loadu_ps(p->e2y), e2z = _mm256_loadu_ps(p->e2z);
+
+  // h = dir x edge2
+  __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+  __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+  __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+  __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+  __m256 f = _mm256_div_ps(one, a);
+
+  __m256 sx = _mm256_sub_ps(_mm256_set1_ps(orig.x), _mm256_loadu_ps(p->v0x));
+  __m256 sy = _mm256_sub_ps(_mm256_set1_ps(orig.y), _mm256_loadu_ps(p->v0y));
+  __m256 sz = _mm256_sub_ps(_mm256_set1_ps(orig.z), _mm256_loadu_ps(p->v0z));
+  __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+
+  // q = s x edge1
+  __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+  __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+  __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+  __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+  __m256 t = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+
+  __m256 hit = _mm256_cmp_ps(_mm256_and_ps(a, abs_mask), eps, _CMP_GE_OQ);
+  hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+  hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, eps, _CMP_GT_OQ));
+
+  _mm256_storeu_ps(out->t, t);
+  _mm256_storeu_ps(out->u, u);
+  _mm256_storeu_ps(out->v, v);
+  out->mask = (uint32_t)_mm256_movemask_ps(hit);
+}
+
+#endif
+
+IntersectPacketFn select_intersect_packet() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return intersect_packet_avx2;
+  if (__builtin_cpu_supports("sse2")) return intersect_packet_sse;
+#endif
+  return intersect_packet_scalar;
+}
+
+IntersectPacketFn intersect_packet = select_intersect_packet();
+
+bool packets_closest_hit(const std::vector<TrianglePacket> &packets, glm::vec3 orig, glm::vec3 dir, float t_max, float *t, uint32_t *triangle) {
+  bool found = false;
+  PacketHit ph;
+  for (uint32_t i = 0; i < packets.size(); i++) {
+    intersect_packet(orig, dir, &packets[i], &ph);
+    for (uint32_t mask = ph.mask; mask; mask &= mask - 1) {
+      uint32_t lane = __builtin_ctz(mask);
+      if (ph.t[lane] < t_max) {
+        t_max = ph.t[lane];
+        *t = t_max;
+        *triangle = i * PACKET_WIDTH + lane;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
 
+glm::mat4 triangle_transform(Triangle triangle) {
   glm::mat4 translate = glm::translate(glm::mat4(1.0f), triangle.translate);
   glm::mat4 scale = glm::scale(glm::mat4(1.0f), triangle.scale);
-  glm::mat4 transform = translate * scale;
-    
-  glUniformMatrix4fv(v_transform, 1, GL_FALSE, &transform[0][0]);
+  return translate * scale;
+}
+
+// World-space data of a triangle that does not depend on the ray. Rebuilt
+// only when the triangle translate/scale differ from the ones it was built
+// with, so static geometry pays the transform and the edge/normal/dot
+// products once instead of on every query.
+typedef struct {
+  glm::vec3 v0, edge1, edge2;
+  glm::vec3 normal;
+  float d00, d01, d11, inv_denom; // check_p_in_triangle terms, inv_denom 0 when degenerate
+  glm::vec3 translate, scale;     // transform the record was built with
+  bool valid;
+} TriangleAccel;
+
+// returns true when the record had to be rebuilt
+bool triangle_accel_update(TriangleAccel *acc, const Vertex *vertices, Triangle triangle) {
+  if (acc->valid && acc->translate == triangle.translate && acc->scale == triangle.scale) return false;
+
+  glm::mat4 transform = triangle_transform(triangle);
+  glm::vec3 A = glm::vec3(transform * vertices[triangle.idxs[0]].position);
+  glm::vec3 B = glm::vec3(transform * vertices[triangle.idxs[1]].position);
+  glm::vec3 C = glm::vec3(transform * vertices[triangle.idxs[2]].position);
+
+  acc->v0 = A;
+  acc->edge1 = B - A;
+  acc->edge2 = C - A;
+  acc->normal = glm::cross(acc->edge1, acc->edge2);
+  acc->d00 = glm::dot(acc->edge1, acc->edge1);
+  acc->d01 = glm::dot(acc->edge1, acc->edge2);
+  acc->d11 = glm::dot(acc->edge2, acc->edge2);
+  float denom = acc->d00 * acc->d11 - acc->d01 * acc->d01;
+  acc->inv_denom = glm::abs(denom) < 1e-6f ? 0.0f : 1.0f / denom;
+  acc->translate = triangle.translate;
+  acc->scale = triangle.scale;
+  acc->valid = true;
+  return true;
+}
+
+bool MollerTrumbore(glm::vec3 orig, glm::vec3 dir, const TriangleAccel *tri, Hit *hit) {
+  return moller_trumbore_edges(orig, dir, tri->v0, tri->edge1, tri->edge2, hit);
+}
+
+bool intersect_ray_triangle(glm::vec3 P0, glm::vec3 P1, const TriangleAccel *tri, Hit *hit) {
+  if (tri->inv_denom == 0.0f) return false;
+
+  glm::vec3 dir = P1 - P0;
+  float denom = glm::dot(tri->normal, dir);
+  if (glm::abs(denom) < 1e-6f) return false;
 
+  float t = glm::dot(tri->normal, tri->v0 - P0) / denom;
+  if (t < 0.0f || t > 1.0f) return false;
+
+  glm::vec3 P = P0 + t * dir;
+  glm::vec3 v2 = P - tri->v0;
+  float d20 = glm::dot(v2, tri->edge1);
+  float d21 = glm::dot(v2, tri->edge2);
+
+  float v = (tri->d11 * d20 - tri->d01 * d21) * tri->inv_denom;
+  float w = (tri->d00 * d21 - tri->d01 * d20) * tri->inv_denom;
+  float u = 1.0f - v - w;
+  if (u < 0.0f || v < 0.0f || w < 0.0f) return false;
+
+  hit->t = t;
+  hit->u = v;
+  hit->v = w;
+  hit->w = u;
+  hit->point = P;
+  return true;
+}
+
+// BVH (bounding volume hierarchy) over the world-space triangles, split with
+// a binned surface area heuristic (SAH).
+
+#define BVH_BINS 16
+#define BVH_STACK_SIZE 64 // also the max tree depth, traversal pushes at most one node per level
+
+typedef struct {
+  glm::vec3 min;
+  glm::vec3 max;
+} AABB;
+
+typedef struct {
+  AABB bounds;
+  uint32_t left_first; // inner node: left child (right is left_first + 1), leaf: first in tri_idxs
+  uint32_t count;      // 0 on inner nodes
+} BVHNode;
+
+typedef struct {
+  std::vector<BVHNode> nodes;
+  std::vector<uint32_t> tri_idxs;   // triangles ordered by leaf
+  std::vector<TriangleAccel> accels; // per triangle, indexed like triangles[]
+  std::vector<glm::vec3> positions; // world-space v0 v1 v2 of each triangle
+  std::vector<glm::vec3> centroids;
+  uint32_t nodes_used;
+  uint32_t tri_count;
+  float build_cost; // SAH cost right after the last full build
+} BVH;
+
+AABB aabb_empty() {
+  return (AABB){ .min = glm::vec3(INFINITY), .max = glm::vec3(-INFINITY) };
+}
+
+void aabb_grow(AABB *b, glm::vec3 p) {
+  b->min = glm::min(b->min, p);
+  b->max = glm::max(b->max, p);
+}
+
+void aabb_merge(AABB *b, AABB o) {
+  b->min = glm::min(b->min, o.min);
+  b->max = glm::max(b->max, o.max);
+}
+
+float aabb_area(AABB b) {
+  glm::vec3 e = b.max - b.min;
+  if (e.x < 0.0f) return 0.0f; // empty
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// distance to the box along the ray, INFINITY when missed or farther than t_max
+float aabb_intersect(const AABB *b, glm::vec3 orig, glm::vec3 inv_dir, float t_max) {
+  float tx1 = (b->min.x - orig.x) * inv_dir.x, tx2 = (b->max.x - orig.x) * inv_dir.x;
+  float tmin = std::min(tx1, tx2), tmax = std::max(tx1, tx2);
+  float ty1 = (b->min.y - orig.y) * inv_dir.y, ty2 = (b->max.y - orig.y) * inv_dir.y;
+  tmin = std::max(tmin, std::min(ty1, ty2)), tmax = std::min(tmax, std::max(ty1, ty2));
+  float tz1 = (b->min.z - orig.z) * inv_dir.z, tz2 = (b->max.z - orig.z) * inv_dir.z;
+  tmin = std::max(tmin, std::min(tz1, tz2)), tmax = std::min(tmax, std::max(tz1, tz2));
+  if (tmax >= tmin && tmin < t_max && tmax > 0.0f) return tmin;
+  return INFINITY;
+}
+
+// returns how many triangles changed since the last load
+uint32_t bvh_load_positions(BVH *bvh, const Vertex *vertices, const Triangle *triangles, uint32_t count) {
+  bvh->accels.resize(count);
+  bvh->positions.resize(count * 3);
+  uint32_t changed = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    TriangleAccel *acc = &bvh->accels[i];
+    if (!triangle_accel_update(acc, vertices, triangles[i])) continue;
+    bvh->positions[i * 3 + 0] = acc->v0;
+    bvh->positions[i * 3 + 1] = acc->v0 + acc->edge1;
+    bvh->positions[i * 3 + 2] = acc->v0 + acc->edge2;
+    changed++;
+  }
+  return changed;
+}
+
+void bvh_update_node_bounds(BVH *bvh, uint32_t node_idx) {
+  BVHNode *node = &bvh->nodes[node_idx];
+  node->bounds = aabb_empty();
+  for (uint32_t i = 0; i < node->count; i++) {
+    uint32_t t = bvh->tri_idxs[node->left_first + i];
+    aabb_grow(&node->bounds, bvh->positions[t * 3 + 0]);
+    aabb_grow(&node->bounds, bvh->positions[t * 3 + 1]);
+    aabb_grow(&node->bounds, bvh->positions[t * 3 + 2]);
+  }
+}
+
+float bvh_find_split(BVH *bvh, const BVHNode *node, int *axis, float *split_pos) {
+  float best_cost = INFINITY;
+
+  for (int a = 0; a < 3; a++) {
+    float cmin = INFINITY, cmax = -INFINITY;
+    for (uint32_t i = 0; i < node->count; i++) {
+      float c = bvh->centroids[bvh->tri_idxs[node->left_first + i]][a];
+      cmin = std::min(cmin, c);
+      cmax = std::max(cmax, c);
+    }
+    if (cmin == cmax) continue;
+
+    AABB bins[BVH_BINS];
+    uint32_t counts[BVH_BINS] = {0};
+    for (int b = 0; b < BVH_BINS; b++) bins[b] = aabb_empty();
+
+    float scale = BVH_BINS / (cmax - cmin);
+    for (uint32_t i = 0; i < node->count; i++) {
+      uint32_t t = bvh->tri_idxs[node->left_first + i];
+      int b = std::min(BVH_BINS - 1, (int)((bvh->centroids[t][a] - cmin) * scale));
+      counts[b]++;
+      aabb_grow(&bins[b], bvh->positions[t * 3 + 0]);
+      aabb_grow(&bins[b], bvh->positions[t * 3 + 1]);
+      aabb_grow(&bins[b], bvh->positions[t * 3 + 2]);
+    }
+
+    // sweep from both sides to get the area/count left and right of every plane
+    float left_area[BVH_BINS - 1], right_area[BVH_BINS - 1];
+    uint32_t left_count[BVH_BINS - 1], right_count[BVH_BINS - 1];
+    AABB left_box = aabb_empty(), right_box = aabb_empty();
+    uint32_t left_sum = 0, right_sum = 0;
+    for (int i = 0; i < BVH_BINS - 1; i++) {
+      left_sum += counts[i];
+      left_count[i] = left_sum;
+      aabb_merge(&left_box, bins[i]);
+      left_area[i] = aabb_area(left_box);
+
+      right_sum += counts[BVH_BINS - 1 - i];
+      right_count[BVH_BINS - 2 - i] = right_sum;
+      aabb_merge(&right_box, bins[BVH_BINS - 1 - i]);
+      right_area[BVH_BINS - 2 - i] = aabb_area(right_box);
+    }
+
+    for (int i = 0; i < BVH_BINS - 1; i++) {
+      float cost = left_count[i] * left_area[i] + right_count[i] * right_area[i];
+      if (cost < best_cost) {
+        best_cost = cost;
+        *axis = a;
+        *split_pos = cmin + (i + 1) / scale;
+      }
+    }
+  }
+  return best_cost;
+}
+
+void bvh_subdivide(BVH *bvh, uint32_t node_idx, uint32_t depth) {
+  BVHNode *node = &bvh->nodes[node_idx];
+  if (node->count <= 2 || depth >= BVH_STACK_SIZE) return;
+
+  int axis = 0;
+  float split_pos = 0.0f;
+  float split_cost = bvh_find_split(bvh, node, &axis, &split_pos);
+  float leaf_cost = node->count * aabb_area(node->bounds);
+  if (split_cost >= leaf_cost) return;
+
+  int32_t i = node->left_first;
+  int32_t j = i + node->count - 1;
+  while (i <= j) {
+    if (bvh->centroids[bvh->tri_idxs[i]][axis] < split_pos) {
+      i++;
+    } else {
+      std::swap(bvh->tri_idxs[i], bvh->tri_idxs[j]);
+      j--;
+    }
+  }
+
+  uint32_t left_count = i - node->left_first;
+  if (left_count == 0 || left_count == node->count) return;
+
+  uint32_t left = bvh->nodes_used++;
+  uint32_t right = bvh->nodes_used++;
+  bvh->nodes[left] = (BVHNode){ .bounds = aabb_empty(), .left_first = node->left_first, .count = left_count };
+  bvh->nodes[right] = (BVHNode){ .bounds = aabb_empty(), .left_first = (uint32_t)i, .count = node->count - left_count };
+  node->left_first = left;
+  node->count = 0;
+
+  bvh_update_node_bounds(bvh, left);
+  bvh_update_node_bounds(bvh, right);
+  bvh_subdivide(bvh, left, depth + 1);
+  bvh_subdivide(bvh, right, depth + 1);
+}
+
+float bvh_cost(const BVH *bvh) {
+  float cost = 0.0f;
+  for (uint32_t i = 0; i < bvh->nodes_used; i++) {
+    const BVHNode *node = &bvh->nodes[i];
+    cost += aabb_area(node->bounds) * (node->count > 0 ? node->count : 1);
+  }
+  return cost;
+}
+
+void bvh_build(BVH *bvh, const Vertex *vertices, const Triangle *triangles, uint32_t count) {
+  bvh->tri_count = count;
+  bvh->nodes_used = 0;
+  if (count == 0) return;
+
+  // triangles may have been replaced, start from fresh records
+  bvh->accels.assign(count, TriangleAccel{});
+  bvh_load_positions(bvh, vertices, triangles, count);
+  bvh->centroids.resize(count);
+  bvh->tri_idxs.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    bvh->tri_idxs[i] = i;
+    bvh->centroids[i] = (bvh->positions[i * 3] + bvh->positions[i * 3 + 1] + bvh->positions[i * 3 + 2]) * (1.0f / 3.0f);
+  }
+
+  bvh->nodes.resize(count * 2);
+  bvh->nodes[0] = (BVHNode){ .bounds = aabb_empty(), .left_first = 0, .count = count };
+  bvh->nodes_used = 1;
+  bvh_update_node_bounds(bvh, 0);
+  bvh_subdivide(bvh, 0, 0);
+  bvh->build_cost = bvh_cost(bvh);
+}
+
+// keeps the tree topology and only recomputes the boxes, children always
+// live after their parent so a reverse sweep is bottom-up. returns false
+// when no triangle moved and nothing had to be done
+bool bvh_refit(BVH *bvh, const Vertex *vertices, const Triangle *triangles) {
+  if (bvh->tri_count == 0) return false;
+  if (bvh_load_positions(bvh, vertices, triangles, bvh->tri_count) == 0) return false;
+
+  for (int32_t i = bvh->nodes_used - 1; i >= 0; i--) {
+    BVHNode *node = &bvh->nodes[i];
+    if (node->count > 0) {
+      bvh_update_node_bounds(bvh, i);
+    } else {
+      node->bounds = bvh->nodes[node->left_first].bounds;
+      aabb_merge(&node->bounds, bvh->nodes[node->left_first + 1].bounds);
+    }
+  }
+  return true;
+}
+
+// refit while the tree is still good, rebuild when triangles were added or
+// removed or the refitted tree got twice as expensive as a fresh one
+void bvh_update(BVH *bvh, const Vertex *vertices, const Triangle *triangles, uint32_t count) {
+  if (count != bvh->tri_count) {
+    bvh_build(bvh, vertices, triangles, count);
+    return;
+  }
+  if (bvh_refit(bvh, vertices, triangles) && bvh_cost(bvh) > 2.0f * bvh->build_cost) {
+    bvh_build(bvh, vertices, triangles, count);
+  }
+}
+
+bool bvh_traverse(const BVH *bvh, glm::vec3 orig, glm::vec3 dir, float t_max, bool any_hit, Hit *hit) {
+  if (bvh->nodes_used == 0) return false;
+
+  glm::vec3 inv_dir = glm::vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+  const BVHNode *stack[BVH_STACK_SIZE];
+  uint32_t sp = 0;
+  const BVHNode *node = &bvh->nodes[0];
+  bool found = false;
+
+  if (aabb_intersect(&node->bounds, orig, inv_dir, t_max) == INFINITY) return false;
+
+  while (true) {
+    if (node->count > 0) {
+      for (uint32_t i = 0; i < node->count; i++) {
+        uint32_t tri = bvh->tri_idxs[node->left_first + i];
+        Hit candidate;
+        if (MollerTrumbore(orig, dir, &bvh->accels[tri], &candidate) && candidate.t < t_max) {
+          t_max = candidate.t;
+          found = true;
+          candidate.triangle = tri;
+          if (hit) *hit = candidate;
+          if (any_hit) return true;
+        }
+      }
+      if (sp == 0) break;
+      node = stack[--sp];
+      continue;
+    }
+
+    const BVHNode *near = &bvh->nodes[node->left_first];
+    const BVHNode *far = &bvh->nodes[node->left_first + 1];
+    float d_near = aabb_intersect(&near->bounds, orig, inv_dir, t_max);
+    float d_far = aabb_intersect(&far->bounds, orig, inv_dir, t_max);
+    if (d_near > d_far) {
+      std::swap(near, far);
+      std::swap(d_near, d_far);
+    }
+
+    if (d_near == INFINITY) {
+      if (sp == 0) break;
+      node = stack[--sp];
+    } else {
+      node = near;
+      if (d_far != INFINITY) stack[sp++] = far;
+    }
+  }
+  return found;
+}
+
+bool bvh_closest_hit(const BVH *bvh, glm::vec3 orig, glm::vec3 dir, float t_max, Hit *hit) {
+  return bvh_traverse(bvh, orig, dir, t_max, false, hit);
+}
+
+bool bvh_any_hit(const BVH *bvh, glm::vec3 orig, glm::vec3 dir, float t_max) {
+  return bvh_traverse(bvh, orig, dir, t_max, true, nullptr);
+}
+
+void draw_triangles(uint32_t VAO, uint32_t program, Vertex *vertices, uint32_t tidx, Triangle triangles[MAX_TRIANGLES], Ray ray, BVH *bvh) {
+  int v_transform = glGetUniformLocation(program, "v_transform");
   glBindVertexArray(VAO);
-  glDrawArrays(GL_TRIANGLES, triangle.idxs[0], 3);  
+
+  for (uint32_t i = 0; i < tidx; ++i) {
+    glm::mat4 transform = triangle_transform(triangles[i]);
+    glUniformMatrix4fv(v_transform, 1, GL_FALSE, &transform[0][0]);
+    glDrawArrays(GL_TRIANGLES, triangles[i].idxs[0], 3);
+  }
 
   glm::mat4 rtranslate = glm::translate(glm::mat4(1.0f), ray.translate);
   glm::mat4 rscale = glm::scale(glm::mat4(1.0f), ray.scale);
@@ -291,21 +878,18 @@ void draw_triangles(uint32_t VAO, uint32_t program, Vertex *vertices, uint32_t t
   glUniformMatrix4fv(v_transform, 1, GL_FALSE, &rtransform[0][0]);
   glDrawArrays(GL_LINE_STRIP, ray.idxs[0], 2);
 
-  //glm::vec3(modelTri * glm::vec4(A_local, 1.0f))
-  
   glm::vec3 P0 = glm::vec3(rtransform * vertices[ray.idxs[0]].position);
   glm::vec3 P1 = glm::vec3(rtransform * vertices[ray.idxs[1]].position);
 
-  glm::vec3 A = glm::vec3(transform * vertices[ray.idxs[0]].position);
-  glm::vec3 B = glm::vec3(transform * vertices[ray.idxs[1]].position);
-  glm::vec3 C = glm::vec3(transform * vertices[ray.idxs[2]].position);
-  
   // if (intersect_ray_triangle(P0, P1, A, B, C)) {
   //   std::cout << "intersecting" << std::endl;
   // }
 
-  if (MollerTrumbore(P0, P1 - P0, A, B, C)) {
-    std::cout << "intersecting" << std::endl;
+  bvh_update(bvh, vertices, triangles, tidx);
+
+  Hit hit;
+  if (bvh_closest_hit(bvh, P0, P1 - P0, INFINITY, &hit)) {
+    std::cout << "intersecting triangle " << hit.triangle << " t: " << hit.t << std::endl;
   }
 }
 
@@ -357,6 +941,7 @@ void loop(GLFWwindow *window) {
 
   Triangle triangles[MAX_TRIANGLES];
   uint32_t tidx = 0;
+  BVH bvh = {};
   
   Vertex vertices[MAX_VERTEX_COUNT];
   uint32_t idx = 0;
@@ -530,7 +1115,7 @@ void loop(GLFWwindow *window) {
     glUseProgram(program);
 
     //glBindVertexArray(VAO);
-    draw_triangles(VAO, program, vertices, tidx, triangles, ray);
+    draw_triangles(VAO, program, vertices, tidx, triangles, ray, &bvh);
 
     
     // std::cout << "total clicks: " << total_click << std::endl;
@@ -543,9 +1128,378 @@ void loop(GLFWwindow *window) {
   glfwDestroyCursor(cursor);
 }
 
-int main(void) {
+void random_mesh(std::mt19937 *rng, uint32_t count, std::vector<Vertex> *vertices, std::vector<Triangle> *triangles) {
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> offset(-0.02f, 0.02f);
+  vertices->resize(count * 3);
+  triangles->resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec3 c = glm::vec3(pos(*rng), pos(*rng), pos(*rng));
+    for (uint32_t k = 0; k < 3; k++) {
+      glm::vec3 p = c + glm::vec3(offset(*rng), offset(*rng), offset(*rng));
+      put_vertice(i * 3 + k, vertices->data(), glm::vec4(p, 1.0f), (Color){ .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f });
+    }
+    (*triangles)[i] = (Triangle){
+      .idxs = { i * 3, i * 3 + 1, i * 3 + 2 },
+      .translate = glm::vec3(0.0f),
+      .scale = glm::vec3(1.0f),
+    };
+  }
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int bench_bvh(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::vector<Vertex> vertices;
+  std::vector<Triangle> triangles;
+  random_mesh(&rng, count, &vertices, &triangles);
+
+  BVH bvh = {};
+  auto start = std::chrono::steady_clock::now();
+  bvh_build(&bvh, vertices.data(), triangles.data(), count);
+  std::cout << "bvh build: " << elapsed_ms(start) << " ms, " << bvh.nodes_used << " nodes" << std::endl;
+
+  for (uint32_t i = 0; i < count; i++) triangles[i].translate = glm::vec3(0.1f, 0.0f, 0.0f);
+  start = std::chrono::steady_clock::now();
+  bvh_refit(&bvh, vertices.data(), triangles.data());
+  std::cout << "bvh refit: " << elapsed_ms(start) << " ms, cost " << bvh_cost(&bvh) / bvh.build_cost << "x of build" << std::endl;
+
+  const uint32_t rays = 100000;
+  std::vector<glm::vec3> origs(rays), dirs(rays);
+  for (uint32_t i = 0; i < rays; i++) {
+    origs[i] = glm::vec3(pos(rng), pos(rng), pos(rng));
+    dirs[i] = glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)));
+  }
+
+  uint32_t hits = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rays; i++) {
+    Hit hit;
+    hits += bvh_closest_hit(&bvh, origs[i], dirs[i], INFINITY, &hit);
+  }
+  double closest_ms = elapsed_ms(start);
+  std::cout << "closest hit: " << closest_ms * 1000.0 / rays << " us/ray, " << hits << "/" << rays << " hits" << std::endl;
+
+  hits = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rays; i++) {
+    hits += bvh_any_hit(&bvh, origs[i], dirs[i], INFINITY);
+  }
+  std::cout << "any hit: " << elapsed_ms(start) * 1000.0 / rays << " us/ray, " << hits << "/" << rays << " hits" << std::endl;
+
+  // brute force check on a few rays
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < 200; i++) {
+    float best = INFINITY;
+    for (uint32_t t = 0; t < count; t++) {
+      Hit hit;
+      if (MollerTrumbore(origs[i], dirs[i], bvh.positions[t * 3], bvh.positions[t * 3 + 1], bvh.positions[t * 3 + 2], &hit) && hit.t < best) best = hit.t;
+    }
+    Hit hit;
+    bool found = bvh_closest_hit(&bvh, origs[i], dirs[i], INFINITY, &hit);
+    if (found != (best != INFINITY) || (found && hit.t != best)) mismatches++;
+  }
+  std::cout << "brute force mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+// Headless ray tracer: one primary ray per pixel, orthographic along +z
+// through the same NDC space the window draws in.
+
+#define TILE_SIZE 32
+
+typedef struct {
+  std::mutex lock;
+  std::deque<uint32_t> items;
+} WorkQueue;
+
+bool work_queue_pop(std::vector<WorkQueue> *queues, uint32_t id, uint32_t *item) {
+  {
+    WorkQueue *own = &(*queues)[id];
+    std::lock_guard<std::mutex> guard(own->lock);
+    if (!own->items.empty()) {
+      *item = own->items.back();
+      own->items.pop_back();
+      return true;
+    }
+  }
+  // own queue is empty, steal from the front of the others
+  for (uint32_t i = 1; i < queues->size(); i++) {
+    WorkQueue *victim = &(*queues)[(id + i) % queues->size()];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (!victim->items.empty()) {
+      *item = victim->items.front();
+      victim->items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+// runs fn(item) for item in [0, count) on a work-stealing pool
+void parallel_for(uint32_t count, uint32_t threads, const std::function<void(uint32_t)> &fn) {
+  if (threads == 0) threads = 1;
+  std::vector<WorkQueue> queues(threads);
+  for (uint32_t i = 0; i < count; i++) {
+    queues[i * threads / count].items.push_back(i);
+  }
+
+  std::vector<std::thread> workers;
+  for (uint32_t id = 0; id < threads; id++) {
+    workers.emplace_back([&queues, &fn, id]() {
+      uint32_t item;
+      while (work_queue_pop(&queues, id, &item)) fn(item);
+    });
+  }
+  for (auto &w : workers) w.join();
+}
+
+Color shade_hit(const Vertex *vertices, const Triangle *triangles, Hit hit) {
+  const Triangle *tri = &triangles[hit.triangle];
+  Color c0 = vertices[tri->idxs[0]].color;
+  Color c1 = vertices[tri->idxs[1]].color;
+  Color c2 = vertices[tri->idxs[2]].color;
+  return (Color){
+    .r = hit.w * c0.r + hit.u * c1.r + hit.v * c2.r,
+    .g = hit.w * c0.g + hit.u * c1.g + hit.v * c2.g,
+    .b = hit.w * c0.b + hit.u * c1.b + hit.v * c2.b,
+    .a = hit.w * c0.a + hit.u * c1.a + hit.v * c2.a,
+  };
+}
+
+void render_tile(const BVH *bvh, const Vertex *vertices, const Triangle *triangles, uint8_t *pixels, uint32_t tile) {
+  uint32_t tiles_x = (WIDTH + TILE_SIZE - 1) / TILE_SIZE;
+  uint32_t x0 = (tile % tiles_x) * TILE_SIZE;
+  uint32_t y0 = (tile / tiles_x) * TILE_SIZE;
+
+  for (uint32_t y = y0; y < std::min(y0 + TILE_SIZE, (uint32_t)HEIGHT); y++) {
+    for (uint32_t x = x0; x < std::min(x0 + TILE_SIZE, (uint32_t)WIDTH); x++) {
+      glm::vec3 p = mouse_to_gl_point(x + 0.5f, y + 0.5f);
+      glm::vec3 orig = glm::vec3(p.x, p.y, -1.0f);
+      Color c = (Color){ .r = 0.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f };
+      Hit hit;
+      if (bvh_closest_hit(bvh, orig, glm::vec3(0.0f, 0.0f, 1.0f), INFINITY, &hit)) {
+        c = shade_hit(vertices, triangles, hit);
+      }
+      uint8_t *px = &pixels[(y * WIDTH + x) * 3];
+      px[0] = (uint8_t)(glm::clamp(c.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+      px[1] = (uint8_t)(glm::clamp(c.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+      px[2] = (uint8_t)(glm::clamp(c.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+  }
+}
+
+int write_ppm(const char *path, const uint8_t *pixels, uint32_t width, uint32_t height) {
+  FILE *f = fopen(path, "wb");
+  if (f == nullptr) {
+    std::cerr << "Could not open " << path << std::endl;
+    std::cerr << "error: " << strerror(errno) << std::endl;
+    return -1;
+  }
+  fprintf(f, "P6\n%u %u\n255\n", width, height);
+  fwrite(pixels, 1, width * height * 3, f);
+  fclose(f);
+  return 0;
+}
+
+int render(const char *path, uint32_t count, uint32_t threads) {
+  std::vector<Vertex> vertices;
+  std::vector<Triangle> triangles;
+
+  if (count == 0) {
+    // same triangle the window shows
+    vertices.resize(3);
+    put_vertice(0, vertices.data(), glm::vec4(0.2f, 0.2, 0.0f, 1.0f), (Color){ .r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f });
+    put_vertice(1, vertices.data(), glm::vec4(0.2f, -0.2, 0.0f, 1.0f), (Color){ .r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f });
+    put_vertice(2, vertices.data(), glm::vec4(-0.2f, 0.2, 0.0f, 1.0f), (Color){ .r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f });
+    triangles.push_back((Triangle){ .idxs = { 0, 1, 2 }, .translate = glm::vec3(0.0f), .scale = glm::vec3(1.0f) });
+  } else {
+    std::mt19937 rng(42);
+    random_mesh(&rng, count, &vertices, &triangles);
+    std::uniform_real_distribution<float> channel(0.0f, 1.0f);
+    for (auto &v : vertices) v.color = (Color){ .r = channel(rng), .g = channel(rng), .b = channel(rng), .a = 1.0f };
+  }
+
+  BVH bvh = {};
+  bvh_build(&bvh, vertices.data(), triangles.data(), triangles.size());
+
+  std::vector<uint8_t> pixels(WIDTH * HEIGHT * 3);
+  uint32_t tiles = ((WIDTH + TILE_SIZE - 1) / TILE_SIZE) * ((HEIGHT + TILE_SIZE - 1) / TILE_SIZE);
+
+  auto start = std::chrono::steady_clock::now();
+  parallel_for(tiles, threads, [&](uint32_t tile) {
+    render_tile(&bvh, vertices.data(), triangles.data(), pixels.data(), tile);
+  });
+  std::cout << "rendered " << WIDTH << "x" << HEIGHT << " with " << threads << " threads in " << elapsed_ms(start) << " ms" << std::endl;
+
+  return write_ppm(path, pixels.data(), WIDTH, HEIGHT);
+}
+
+int bench_packet(uint32_t count) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::vector<Vertex> vertices;
+  std::vector<Triangle> triangles;
+  random_mesh(&rng, count, &vertices, &triangles);
+
+  std::vector<glm::vec3> positions(count * 3);
+  for (uint32_t i = 0; i < count * 3; i++) positions[i] = glm::vec3(vertices[i].position);
+  std::vector<TrianglePacket> packets;
+  triangle_packets_build(positions.data(), count, &packets);
+
+  const uint32_t rays = 2000;
+  std::vector<glm::vec3> origs(rays), dirs(rays);
+  for (uint32_t i = 0; i < rays; i++) {
+    origs[i] = glm::vec3(pos(rng), pos(rng), pos(rng));
+    dirs[i] = glm::normalize(glm::vec3(pos(rng), pos(rng), pos(rng)));
+  }
+  double tests = (double)rays * count;
+
+  std::vector<float> reference(rays, INFINITY);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rays; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      Hit hit;
+      if (MollerTrumbore(origs[r], dirs[r], positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], &hit) && hit.t < reference[r]) reference[r] = hit.t;
+    }
+  }
+  double scalar_ms = elapsed_ms(start);
+  std::cout << "glm scalar: " << scalar_ms * 1e6 / tests << " ns/test" << std::endl;
+
+  struct { const char *name; IntersectPacketFn fn; bool supported; } kernels[] = {
+    { "packet scalar", intersect_packet_scalar, true },
+#if defined(__x86_64__) || defined(__i386__)
+    { "packet sse", intersect_packet_sse, (bool)__builtin_cpu_supports("sse2") },
+    { "packet avx2", intersect_packet_avx2, (bool)__builtin_cpu_supports("avx2") },
+#endif
+  };
+
+  IntersectPacketFn selected = intersect_packet;
+  uint32_t mismatches = 0;
+  for (auto &k : kernels) {
+    if (!k.supported) continue;
+    intersect_packet = k.fn;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rays; r++) {
+      float t = INFINITY;
+      uint32_t tri = 0;
+      packets_closest_hit(packets, origs[r], dirs[r], INFINITY, &t, &tri);
+      if (t != reference[r]) mismatches++;
+    }
+    double ms = elapsed_ms(start);
+    std::cout << k.name << ": " << ms * 1e6 / tests << " ns/test, " << scalar_ms / ms << "x" << (k.fn == selected ? " (selected)" : "") << std::endl;
+  }
+  intersect_packet = selected;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+int bench_hit(uint32_t count) {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::vector<Vertex> vertices;
+  std::vector<Triangle> triangles;
+  random_mesh(&rng, count, &vertices, &triangles);
+
+  // one segment per triangle, aimed close to its centroid so about half hit.
+  // the mesh triangles are grown 10x, check_p_in_triangle rejects tiny ones
+  // as degenerate
+  std::vector<glm::vec3> positions(count * 3), p0s(count), p1s(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec3 c = glm::vec3(vertices[i * 3].position + vertices[i * 3 + 1].position + vertices[i * 3 + 2].position) * (1.0f / 3.0f);
+    for (uint32_t k = 0; k < 3; k++) positions[i * 3 + k] = c + (glm::vec3(vertices[i * 3 + k].position) - c) * 10.0f;
+    glm::vec3 target = c + glm::vec3(pos(rng), pos(rng), pos(rng)) * 0.1f;
+    p0s[i] = glm::vec3(pos(rng), pos(rng), pos(rng));
+    p1s[i] = p0s[i] + (target - p0s[i]) * 2.0f;
+  }
+
+  std::vector<Hit> plane_hits(count), mt_hits(count);
+  std::vector<bool> plane_found(count), mt_found(count);
+  const uint32_t rounds = 20;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      plane_found[i] = intersect_ray_triangle(p0s[i], p1s[i], positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], &plane_hits[i]);
+    }
+  }
+  double plane_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      mt_found[i] = MollerTrumbore(p0s[i], p1s[i] - p0s[i], positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2], &mt_hits[i]) && mt_hits[i].t <= 1.0f;
+    }
+  }
+  double mt_ms = elapsed_ms(start);
+
+  std::vector<TriangleAccel> accels(count, TriangleAccel{});
+  for (uint32_t i = 0; i < count; i++) {
+    Vertex tri_vertices[3];
+    for (uint32_t k = 0; k < 3; k++) put_vertice(k, tri_vertices, glm::vec4(positions[i * 3 + k], 1.0f), vertices[i * 3 + k].color);
+    triangle_accel_update(&accels[i], tri_vertices, (Triangle){ .idxs = { 0, 1, 2 }, .translate = glm::vec3(0.0f), .scale = glm::vec3(1.0f) });
+  }
+
+  uint32_t accel_disagree = 0;
+  Hit hit;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      accel_disagree += intersect_ray_triangle(p0s[i], p1s[i], &accels[i], &hit) != plane_found[i];
+    }
+  }
+  double plane_accel_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      accel_disagree += (MollerTrumbore(p0s[i], p1s[i] - p0s[i], &accels[i], &hit) && hit.t <= 1.0f) != mt_found[i];
+    }
+  }
+  double mt_accel_ms = elapsed_ms(start);
+
+  uint32_t hits = 0, disagree = 0;
+  float max_point_error = 0.0f;
+  for (uint32_t i = 0; i < count; i++) {
+    hits += mt_found[i];
+    if (plane_found[i] != mt_found[i]) {
+      disagree++;
+    } else if (mt_found[i]) {
+      max_point_error = std::max(max_point_error, glm::length(plane_hits[i].point - mt_hits[i].point));
+    }
+  }
+
+  double tests = (double)rounds * count;
+  std::cout << "plane + barycentric: " << plane_ms * 1e6 / tests << " ns/test" << std::endl;
+  std::cout << "moller trumbore: " << mt_ms * 1e6 / tests << " ns/test, " << plane_ms / mt_ms << "x" << std::endl;
+  std::cout << "plane + barycentric, precomputed: " << plane_accel_ms * 1e6 / tests << " ns/test, " << plane_ms / plane_accel_ms << "x" << std::endl;
+  std::cout << "moller trumbore, precomputed: " << mt_accel_ms * 1e6 / tests << " ns/test, " << plane_ms / mt_accel_ms << "x" << std::endl;
+  std::cout << "precomputed disagree: " << (double)accel_disagree / rounds << std::endl;
+  std::cout << hits << "/" << count << " hits, " << disagree << " disagree, max point error " << max_point_error << std::endl;
+  return accel_disagree == 0 && disagree == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
   std::cout << "hello, world!" << std::endl;
 
+  if (argc > 1 && strcmp(argv[1], "bench-bvh") == 0) {
+    return bench_bvh(argc > 2 ? atoi(argv[2]) : 100000);
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-packet") == 0) {
+    return bench_packet(argc > 2 ? atoi(argv[2]) : 10000);
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-hit") == 0) {
+    return bench_hit(argc > 2 ? atoi(argv[2]) : 100000);
+  }
+  if (argc > 2 && strcmp(argv[1], "render") == 0) {
+    uint32_t threads = argc > 4 ? atoi(argv[4]) : std::thread::hardware_concurrency();
+    return render(argv[2], argc > 3 ? atoi(argv[3]) : 0, threads) == 0 ? 0 : 1;
+  }
+
   if (!glfwInit()) {
     std::cerr << "Could not initialize glfw!" << std::endl;
     std::cerr << "error: " << strerror(errno) << std::endl;
@@ -6,6 +6,13 @@
 #include <chrono>
 #include <thread>
 #include <vector>
+#include <random>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
@@ -144,11 +151,16 @@ typedef struct {
 } Vertex;
 
 typedef struct {
-  std::vector<uint32_t> idxs;
+  std::vector<uint32_t> outline; // vertices in order
+  std::vector<uint32_t> idxs;    // triangles, indices into the shared vertex pool
   glm::vec3 translate;
   glm::vec3 scale;
 } PolyGon;
 
+typedef struct {
+  uint32_t idxs[2]; // line vertexs
+} Line;
+
 uint32_t put_vertice(uint32_t idx, Vertex vertices[MAX_VERTEX_COUNT], glm::vec4 pos, glm::vec4 color) {
   vertices[idx].position = pos;
   vertices[idx].color = color;
@@ -157,30 +169,39 @@ uint32_t put_vertice(uint32_t idx, Vertex vertices[MAX_VERTEX_COUNT], glm::vec4
 
 enum Edge { LEFT, RIGHT, BOTTOM, TOP };
 
+#define ALL_EDGES 0xf
+
+// bit e set when p is outside edge e
+uint32_t outcode(glm::vec2 p, glm::vec2 e_min, glm::vec2 e_max) {
+  return (uint32_t)(p.x < e_min.x) << LEFT | (uint32_t)(p.x > e_max.x) << RIGHT |
+         (uint32_t)(p.y < e_min.y) << BOTTOM | (uint32_t)(p.y > e_max.y) << TOP;
+}
+
+// signed distance from p to the edge, inside when >= 0. LEFT/RIGHT test x,
+// BOTTOM/TOP test y, the odd edges are the max side
+float edge_distance(glm::vec2 p, Edge e, glm::vec2 e_min, glm::vec2 e_max) {
+  uint32_t axis = e >> 1;
+  float d = p[axis] - ((e & 1) ? e_max[axis] : e_min[axis]);
+  return (e & 1) ? -d : d;
+}
+
 bool point_inside(glm::vec2 p, Edge e, glm::vec2 e_min, glm::vec2 e_max) {
-  switch (e) {
-  case LEFT: return p.x >= e_min.x;
-  case RIGHT: return p.x <= e_max.x;
-  case BOTTOM: return p.y >= e_min.y;
-  case TOP: return p.y <= e_max.y;
-  default:
-    return false;
-  }
+  return edge_distance(p, e, e_min, e_max) >= 0.0f;
+}
+
+// point of v1-v2 at t = d1 / (d1 - d2), snapped onto the edge. d1 and d2 have
+// opposite signs so the divisor is never zero, even for horizontal or
+// vertical segments
+glm::vec2 edge_point(glm::vec2 v1, glm::vec2 v2, float d1, float d2, Edge e, glm::vec2 e_min, glm::vec2 e_max) {
+  glm::vec2 p = v1 + (v2 - v1) * (d1 / (d1 - d2));
+  uint32_t axis = e >> 1;
+  p[axis] = (e & 1) ? e_max[axis] : e_min[axis];
+  return p;
 }
 
 // Compute intersection of line segment (v1-v2) with clip edge
 glm::vec2 intersec(glm::vec2 v1, glm::vec2 v2, Edge e, glm::vec2 e_min, glm::vec2 e_max) {
-  float dx = v2.x - v1.x;
-  float dy = v2.y - v1.y;
-  float slope = dx / dy;
-  
-  switch (e) {
-  case LEFT:   return glm::vec2(e_min.x, v1.y + (e_min.x - v1.x) / slope);
-  case RIGHT:  return glm::vec2(e_max.x, v1.y + (e_max.x - v1.x) / slope);
-  case BOTTOM: return glm::vec2(v1.x + (e_min.y - v1.y) * slope, e_min.y);
-  case TOP:    return glm::vec2(v1.x + (e_max.y - v1.y) * slope, e_max.y);
-  default:     return v1;
-  }
+  return edge_point(v1, v2, edge_distance(v1, e, e_min, e_max), edge_distance(v2, e, e_min, e_max), e, e_min, e_max);
 }
 
 typedef struct {
@@ -209,59 +230,698 @@ std::vector<Vertex> clip(Vertex v1, std::vector<Vertex> vs, Edge e, glm::vec2 e_
   return pv;
 }
 
-PolyGon sutherland_hodgman(uint32_t idx, Vertex *vertices, PolyGon p, glm::vec2 e_min, glm::vec2 e_max) {
-  PolyGon p_out;
-  std::vector<Vertex> verts;
+// Sutherland-Hodgman without per-edge allocations: every edge reads one
+// scratch buffer and writes the other. The buffers only grow, so after the
+// first few polygons clipping no longer touches the allocator.
+typedef struct {
+  std::vector<Vertex> a;
+  std::vector<Vertex> b;
+} ClipScratch;
+
+// clips n vertices of in against one edge into out, returns the output count
+uint32_t clip_edge(const Vertex *in, uint32_t n, Vertex *out, Edge e, glm::vec2 e_min, glm::vec2 e_max) {
+  uint32_t count = 0;
+  const Vertex *v1 = &in[n - 1];
+  float d1 = edge_distance(glm::vec2(v1->position.x, v1->position.y), e, e_min, e_max);
+
+  for (uint32_t i = 0; i < n; i++) {
+    const Vertex *v2 = &in[i];
+    float d2 = edge_distance(glm::vec2(v2->position.x, v2->position.y), e, e_min, e_max);
+    if ((d1 >= 0.0f) != (d2 >= 0.0f)) {
+      glm::vec2 pos = edge_point(glm::vec2(v1->position.x, v1->position.y), glm::vec2(v2->position.x, v2->position.y), d1, d2, e, e_min, e_max);
+      out[count++] = (Vertex){ .position = glm::vec4(pos.x, pos.y, 0.0f, 1.0f), .color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) };
+    }
+    if (d2 >= 0.0f) out[count++] = *v2;
+    v1 = v2;
+    d1 = d2;
+  }
+  return count;
+}
+
+// clips one polygon against the edges set in the edges mask, *out points into
+// the scratch buffers and stays valid until the next call with the same scratch
+uint32_t clip_polygon_edges(ClipScratch *scratch, const Vertex *vertices, const uint32_t *idxs, uint32_t n, glm::vec2 e_min, glm::vec2 e_max, uint32_t edges, Vertex **out) {
+  // each edge adds at most one vertex
+  if (scratch->a.size() < n + 4) {
+    scratch->a.resize(n + 4);
+    scratch->b.resize(n + 4);
+  }
+  Vertex *src = scratch->a.data();
+  Vertex *dst = scratch->b.data();
+  for (uint32_t i = 0; i < n; i++) src[i] = vertices[idxs[i]];
+
+  for (uint32_t e = 0; e < 4 && n > 0; e++) {
+    if (!(edges & (1u << e))) continue;
+    n = clip_edge(src, n, dst, (Edge)e, e_min, e_max);
+    std::swap(src, dst);
+  }
+  *out = src;
+  return n;
+}
+
+uint32_t clip_polygon(ClipScratch *scratch, const Vertex *vertices, const uint32_t *idxs, uint32_t n, glm::vec2 e_min, glm::vec2 e_max, Vertex **out) {
+  return clip_polygon_edges(scratch, vertices, idxs, n, e_min, e_max, ALL_EDGES, out);
+}
+
+// output of clip_polygons, polygon i is vertices[offsets[i] .. offsets[i + 1])
+typedef struct {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> offsets;
+} ClipBatch;
+
+void clip_polygons(ClipScratch *scratch, const Vertex *vertices, const PolyGon *polys, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, ClipBatch *out) {
+  out->vertices.clear();
+  out->offsets.clear();
+  out->offsets.push_back(0);
+  for (uint32_t i = 0; i < count; i++) {
+    Vertex *clipped;
+    uint32_t n = clip_polygon(scratch, vertices, polys[i].outline.data(), polys[i].outline.size(), e_min, e_max, &clipped);
+    out->vertices.insert(out->vertices.end(), clipped, clipped + n);
+    out->offsets.push_back(out->vertices.size());
+  }
+}
+
+// SoA classification for polygon soups: every vertex position is gathered into
+// x/y arrays padded to CLIP_LANES and the outcodes of all four edges are
+// computed CLIP_LANES vertices per compare. Polygons fully inside, or fully
+// outside one edge, never reach clip_edge, the rest only clip the edges some
+// of their vertices are outside of.
+#define CLIP_LANES 8
+
+typedef struct {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<uint32_t> codes;
+} ClipSoA;
+
+// count is a multiple of CLIP_LANES
+typedef void (*ClassifyFn)(const float *x, const float *y, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, uint32_t *codes);
+
+void classify_scalar(const float *x, const float *y, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, uint32_t *codes) {
+  for (uint32_t i = 0; i < count; i++) codes[i] = outcode(glm::vec2(x[i], y[i]), e_min, e_max);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+void classify_sse(const float *x, const float *y, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, uint32_t *codes) {
+  __m128 x_min = _mm_set1_ps(e_min.x), x_max = _mm_set1_ps(e_max.x);
+  __m128 y_min = _mm_set1_ps(e_min.y), y_max = _mm_set1_ps(e_max.y);
+  __m128 left = _mm_castsi128_ps(_mm_set1_epi32(1 << LEFT));
+  __m128 right = _mm_castsi128_ps(_mm_set1_epi32(1 << RIGHT));
+  __m128 bottom = _mm_castsi128_ps(_mm_set1_epi32(1 << BOTTOM));
+  __m128 top = _mm_castsi128_ps(_mm_set1_epi32(1 << TOP));
+
+  for (uint32_t i = 0; i < count; i += 4) {
+    __m128 px = _mm_loadu_ps(x + i);
+    __m128 py = _mm_loadu_ps(y + i);
+    __m128 c = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(px, x_min), left), _mm_and_ps(_mm_cmpgt_ps(px, x_max), right));
+    c = _mm_or_ps(c, _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(py, y_min), bottom), _mm_and_ps(_mm_cmpgt_ps(py, y_max), top)));
+    _mm_storeu_si128((__m128i *)(codes + i), _mm_castps_si128(c));
+  }
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const float *x, const float *y, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, uint32_t *codes) {
+  __m256 x_min = _mm256_set1_ps(e_min.x), x_max = _mm256_set1_ps(e_max.x);
+  __m256 y_min = _mm256_set1_ps(e_min.y), y_max = _mm256_set1_ps(e_max.y);
+  __m256 left = _mm256_castsi256_ps(_mm256_set1_epi32(1 << LEFT));
+  __m256 right = _mm256_castsi256_ps(_mm256_set1_epi32(1 << RIGHT));
+  __m256 bottom = _mm256_castsi256_ps(_mm256_set1_epi32(1 << BOTTOM));
+  __m256 top = _mm256_castsi256_ps(_mm256_set1_epi32(1 << TOP));
+
+  for (uint32_t i = 0; i < count; i += 8) {
+    __m256 px = _mm256_loadu_ps(x + i);
+    __m256 py = _mm256_loadu_ps(y + i);
+    __m256 c = _mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(px, x_min, _CMP_LT_OQ), left), _mm256_and_ps(_mm256_cmp_ps(px, x_max, _CMP_GT_OQ), right));
+    c = _mm256_or_ps(c, _mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(py, y_min, _CMP_LT_OQ), bottom), _mm256_and_ps(_mm256_cmp_ps(py, y_max, _CMP_GT_OQ), top)));
+    _mm256_storeu_si256((__m256i *)(codes + i), _mm256_castps_si256(c));
+  }
+}
+#endif
+
+ClassifyFn select_classify() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return classify_avx2;
+  if (__builtin_cpu_supports("sse2")) return classify_sse;
+#endif
+  return classify_scalar;
+}
+
+ClassifyFn classify = select_classify();
+
+// same output as clip_polygons, except out->vertices is kept at its high water
+// mark, entries past offsets[count] are stale
+void clip_polygons_soa(ClipSoA *soa, ClipScratch *scratch, const Vertex *vertices, const PolyGon *polys, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, ClipBatch *out) {
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < count; i++) total += polys[i].outline.size();
+  uint32_t padded = (total + CLIP_LANES - 1) / CLIP_LANES * CLIP_LANES;
+  if (soa->x.size() < padded) {
+    soa->x.resize(padded);
+    soa->y.resize(padded);
+    soa->codes.resize(padded);
+  }
+
+  uint32_t k = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t idx : polys[i].outline) {
+      soa->x[k] = vertices[idx].position.x;
+      soa->y[k] = vertices[idx].position.y;
+      k++;
+    }
+  }
+  for (; k < padded; k++) soa->x[k] = soa->y[k] = 0.0f;
+  classify(soa->x.data(), soa->y.data(), padded, e_min, e_max, soa->codes.data());
+
+  // clipping against four edges adds at most four vertices per polygon
+  if (out->vertices.size() < total + 4 * count) out->vertices.resize(total + 4 * count);
+  out->offsets.resize(count + 1);
+  out->offsets[0] = 0;
+  Vertex *dst = out->vertices.data();
+  const uint32_t *codes = soa->codes.data();
+  for (uint32_t i = 0; i < count; i++) {
+    const std::vector<uint32_t> &idxs = polys[i].outline;
+    uint32_t n = idxs.size();
+    uint32_t outside_all = ALL_EDGES, outside_any = 0;
+    for (uint32_t j = 0; j < n; j++) {
+      outside_all &= codes[j];
+      outside_any |= codes[j];
+    }
+    codes += n;
+
+    if (n == 0 || outside_all) {
+      n = 0;
+    } else if (!outside_any) {
+      for (uint32_t j = 0; j < n; j++) dst[j] = vertices[idxs[j]];
+    } else {
+      Vertex *clipped;
+      n = clip_polygon_edges(scratch, vertices, idxs.data(), n, e_min, e_max, outside_any, &clipped);
+      memcpy(dst, clipped, n * sizeof(Vertex));
+    }
+    dst += n;
+    out->offsets[i + 1] = out->offsets[i] + n;
+  }
+}
+
+// Line clipping. Cohen-Sutherland walks the outcodes moving one endpoint onto
+// an edge per step, Liang-Barsky solves the entry and exit t of the segment
+// against all four edges at once. The window only draws filled polygons, so
+// these are exercised by bench-lines.
+bool cohen_sutherland(glm::vec2 *p0, glm::vec2 *p1, glm::vec2 e_min, glm::vec2 e_max) {
+  uint32_t c0 = outcode(*p0, e_min, e_max);
+  uint32_t c1 = outcode(*p1, e_min, e_max);
+  while (true) {
+    if (!(c0 | c1)) return true;
+    if (c0 & c1) return false;
+    uint32_t c = c0 ? c0 : c1;
+    Edge e = (Edge)__builtin_ctz(c);
+    glm::vec2 p = intersec(*p0, *p1, e, e_min, e_max);
+    if (c == c0) {
+      *p0 = p;
+      c0 = outcode(p, e_min, e_max);
+    } else {
+      *p1 = p;
+      c1 = outcode(p, e_min, e_max);
+    }
+  }
+}
+
+// the visible part of p0-p1 is [t0, t1], false when there is none
+bool liang_barsky(glm::vec2 p0, glm::vec2 p1, glm::vec2 e_min, glm::vec2 e_max, float *t0, float *t1) {
+  float a = 0.0f, b = 1.0f;
+  for (uint32_t e = 0; e < 4; e++) {
+    float q = edge_distance(p0, (Edge)e, e_min, e_max);
+    float p = q - edge_distance(p1, (Edge)e, e_min, e_max);
+    if (p == 0.0f) {
+      // parallel to the edge
+      if (q < 0.0f) return false;
+      continue;
+    }
+    float r = q / p;
+    if (p < 0.0f) {
+      if (r > b) return false;
+      if (r > a) a = r;
+    } else {
+      if (r < a) return false;
+      if (r < b) b = r;
+    }
+  }
+  *t0 = a;
+  *t1 = b;
+  return true;
+}
+
+// clips a batch of lines into out as GL_LINES vertex pairs, returns how many
+// lines are left. Endpoint outcodes are classified in bulk like
+// clip_polygons_soa, only lines that are neither fully inside nor fully
+// outside one edge go through Liang-Barsky. New endpoints are marked red
+// like the polygon clipper does
+uint32_t clip_lines(ClipSoA *soa, const Vertex *vertices, const Line *lines, uint32_t count, glm::vec2 e_min, glm::vec2 e_max, std::vector<Vertex> *out) {
+  uint32_t padded = (2 * count + CLIP_LANES - 1) / CLIP_LANES * CLIP_LANES;
+  if (soa->x.size() < padded) {
+    soa->x.resize(padded);
+    soa->y.resize(padded);
+    soa->codes.resize(padded);
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t k = 0; k < 2; k++) {
+      soa->x[2 * i + k] = vertices[lines[i].idxs[k]].position.x;
+      soa->y[2 * i + k] = vertices[lines[i].idxs[k]].position.y;
+    }
+  }
+  for (uint32_t k = 2 * count; k < padded; k++) soa->x[k] = soa->y[k] = 0.0f;
+  classify(soa->x.data(), soa->y.data(), padded, e_min, e_max, soa->codes.data());
+
+  out->clear();
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t c0 = soa->codes[2 * i], c1 = soa->codes[2 * i + 1];
+    if (c0 & c1) continue;
+    Vertex v0 = vertices[lines[i].idxs[0]];
+    Vertex v1 = vertices[lines[i].idxs[1]];
+    if (c0 | c1) {
+      glm::vec2 p0 = glm::vec2(v0.position.x, v0.position.y);
+      glm::vec2 p1 = glm::vec2(v1.position.x, v1.position.y);
+      float t0, t1;
+      if (!liang_barsky(p0, p1, e_min, e_max, &t0, &t1)) continue;
+      glm::vec2 d = p1 - p0;
+      if (c0) v0 = (Vertex){ .position = glm::vec4(p0 + d * t0, 0.0f, 1.0f), .color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) };
+      if (c1) v1 = (Vertex){ .position = glm::vec4(p0 + d * t1, 0.0f, 1.0f), .color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) };
+    }
+    out->push_back(v0);
+    out->push_back(v1);
+  }
+  return out->size() / 2;
+}
+
+// Convex clip window given by its edge lines, dot(normal, p) + offset >= 0
+// inside. Built once per window and shared by every polygon and line clipped
+// against it, the window can be rotated and in either winding.
+typedef struct {
+  std::vector<glm::vec2> normals;
+  std::vector<float> offsets;
+} ClipWindow;
+
+// false when the outline is degenerate or not convex
+bool clip_window_build(ClipWindow *window, const glm::vec2 *points, uint32_t n) {
+  window->normals.clear();
+  window->offsets.clear();
+  if (n < 3) return false;
+
+  float area = 0.0f;
+  for (uint32_t i = 0; i < n; i++) {
+    glm::vec2 a = points[i], b = points[(i + 1) % n];
+    area += a.x * b.y - b.x * a.y;
+  }
+  if (area == 0.0f) return false;
+  float side = area > 0.0f ? 1.0f : -1.0f; // inside is left of ccw edges
+
+  for (uint32_t i = 0; i < n; i++) {
+    glm::vec2 a = points[i], b = points[(i + 1) % n];
+    glm::vec2 normal = glm::vec2(a.y - b.y, b.x - a.x) * side;
+    if (normal == glm::vec2(0.0f)) continue; // repeated point
+    window->normals.push_back(normal);
+    window->offsets.push_back(-glm::dot(normal, a));
+  }
+
+  for (uint32_t e = 0; e < window->normals.size(); e++) {
+    for (uint32_t i = 0; i < n; i++) {
+      float d = glm::dot(window->normals[e], points[i]) + window->offsets[e];
+      if (d < -1e-5f * glm::length(window->normals[e])) return false;
+    }
+  }
+  return true;
+}
 
+// outline points of a polygon with its translate and scale applied
+void polygon_points(const Vertex *vertices, const uint32_t *idxs, uint32_t n, glm::vec3 translate, glm::vec3 scale, glm::vec2 *points) {
+  for (uint32_t i = 0; i < n; i++) {
+    glm::vec4 p = vertices[idxs[i]].position;
+    points[i] = glm::vec2(p.x * scale.x + translate.x, p.y * scale.y + translate.y);
+  }
+}
+
+float window_distance(const ClipWindow *window, uint32_t e, glm::vec2 p) {
+  return glm::dot(window->normals[e], p) + window->offsets[e];
+}
+
+uint32_t clip_edge_window(const Vertex *in, uint32_t n, Vertex *out, const ClipWindow *window, uint32_t e) {
+  uint32_t count = 0;
+  const Vertex *v1 = &in[n - 1];
+  float d1 = window_distance(window, e, glm::vec2(v1->position.x, v1->position.y));
+
+  for (uint32_t i = 0; i < n; i++) {
+    const Vertex *v2 = &in[i];
+    float d2 = window_distance(window, e, glm::vec2(v2->position.x, v2->position.y));
+    if ((d1 >= 0.0f) != (d2 >= 0.0f)) {
+      glm::vec2 pos = glm::mix(glm::vec2(v1->position.x, v1->position.y), glm::vec2(v2->position.x, v2->position.y), d1 / (d1 - d2));
+      out[count++] = (Vertex){ .position = glm::vec4(pos.x, pos.y, 0.0f, 1.0f), .color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) };
+    }
+    if (d2 >= 0.0f) out[count++] = *v2;
+    v1 = v2;
+    d1 = d2;
+  }
+  return count;
+}
+
+// clip_polygon against a convex window
+uint32_t clip_polygon_window(ClipScratch *scratch, const Vertex *vertices, const uint32_t *idxs, uint32_t n, const ClipWindow *window, Vertex **out) {
+  uint32_t edges = window->normals.size();
+  // each edge adds at most one vertex
+  if (scratch->a.size() < n + edges) {
+    scratch->a.resize(n + edges);
+    scratch->b.resize(n + edges);
+  }
+  Vertex *src = scratch->a.data();
+  Vertex *dst = scratch->b.data();
+  for (uint32_t i = 0; i < n; i++) src[i] = vertices[idxs[i]];
+
+  for (uint32_t e = 0; e < edges && n > 0; e++) {
+    n = clip_edge_window(src, n, dst, window, e);
+    std::swap(src, dst);
+  }
+  *out = src;
+  return n;
+}
+
+// Cyrus-Beck, liang_barsky for a convex window
+bool cyrus_beck(glm::vec2 p0, glm::vec2 p1, const ClipWindow *window, float *t0, float *t1) {
+  float a = 0.0f, b = 1.0f;
+  for (uint32_t e = 0; e < window->normals.size(); e++) {
+    float q = window_distance(window, e, p0);
+    float p = q - window_distance(window, e, p1);
+    if (p == 0.0f) {
+      if (q < 0.0f) return false;
+      continue;
+    }
+    float r = q / p;
+    if (p < 0.0f) {
+      if (r > b) return false;
+      if (r > a) a = r;
+    } else {
+      if (r < a) return false;
+      if (r < b) b = r;
+    }
+  }
+  *t0 = a;
+  *t1 = b;
+  return true;
+}
+
+// Triangulation into the shared vertex pool: a polygon keeps its outline as
+// indices and is drawn from 3 * (n - 2) indices instead of duplicated
+// vertices. Convex outlines are fanned, anything else goes through ear
+// clipping, so concave input and concave clip results draw right too.
+float triangle_cross(glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+  return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// b is an ear when a b c turns like the polygon and no other vertex of the
+// remaining ring is inside a b c
+bool is_ear(const Vertex *vertices, const uint32_t *ring, uint32_t m, uint32_t a, uint32_t b, uint32_t c, float side) {
+  glm::vec2 pa = glm::vec2(vertices[a].position), pb = glm::vec2(vertices[b].position), pc = glm::vec2(vertices[c].position);
+  if (triangle_cross(pa, pb, pc) * side <= 0.0f) return false;
+  for (uint32_t k = 0; k < m; k++) {
+    uint32_t v = ring[k];
+    if (v == a || v == b || v == c) continue;
+    glm::vec2 p = glm::vec2(vertices[v].position);
+    if (triangle_cross(pa, pb, p) * side >= 0.0f && triangle_cross(pb, pc, p) * side >= 0.0f && triangle_cross(pc, pa, p) * side >= 0.0f) return false;
+  }
+  return true;
+}
+
+// appends the triangles of outline to idxs, work is reused between calls
+void triangulate(const Vertex *vertices, const uint32_t *outline, uint32_t n, std::vector<uint32_t> *work, std::vector<uint32_t> *idxs) {
+  if (n < 3) return;
+
+  float area = 0.0f;
+  bool positive = false, negative = false;
+  for (uint32_t i = 0; i < n; i++) {
+    glm::vec2 a = glm::vec2(vertices[outline[i]].position);
+    glm::vec2 b = glm::vec2(vertices[outline[(i + 1) % n]].position);
+    glm::vec2 c = glm::vec2(vertices[outline[(i + 2) % n]].position);
+    area += a.x * b.y - b.x * a.y;
+    float cross = triangle_cross(a, b, c);
+    if (cross > 0.0f) positive = true;
+    if (cross < 0.0f) negative = true;
+  }
+
+  const uint32_t *ring = outline;
+  uint32_t m = n;
+  if (positive && negative) {
+    float side = area > 0.0f ? 1.0f : -1.0f;
+    work->assign(outline, outline + n);
+    uint32_t i = 0, misses = 0;
+    while (m > 3 && misses < m) {
+      uint32_t a = (*work)[(i + m - 1) % m], b = (*work)[i], c = (*work)[(i + 1) % m];
+      if (is_ear(vertices, work->data(), m, a, b, c, side)) {
+        idxs->push_back(a);
+        idxs->push_back(b);
+        idxs->push_back(c);
+        work->erase(work->begin() + i);
+        m--;
+        misses = 0;
+        if (i == m) i = 0;
+      } else {
+        i = (i + 1) % m;
+        misses++;
+      }
+    }
+    ring = work->data();
+  }
+
+  // convex, the last ear, or a degenerate outline no ear can be cut from
+  for (uint32_t k = 1; k + 1 < m; k++) {
+    idxs->push_back(ring[0]);
+    idxs->push_back(ring[k]);
+    idxs->push_back(ring[k + 1]);
+  }
+}
+
+// appends n vertices to the pool at *idx and triangulates them
+PolyGon put_polygon(uint32_t *idx, Vertex *vertices, const Vertex *verts, uint32_t n, std::vector<uint32_t> *work) {
+  PolyGon p = (PolyGon){
+    .outline = {},
+    .idxs = {},
+    .translate = glm::vec3(0.0f),
+    .scale = glm::vec3(1.0f),
+  };
+  if (*idx + n > MAX_VERTEX_COUNT) return p;
+  for (uint32_t i = 0; i < n; i++) {
+    p.outline.push_back(*idx);
+    vertices[(*idx)++] = verts[i];
+  }
+  triangulate(vertices, p.outline.data(), n, work, &p.idxs);
+  return p;
+}
+
+PolyGon sutherland_hodgman(uint32_t *idx, Vertex *vertices, ClipScratch *scratch, std::vector<uint32_t> *work, PolyGon p, const ClipWindow *window) {
+  Vertex *verts;
+  uint32_t count = clip_polygon_window(scratch, vertices, p.outline.data(), p.outline.size(), window, &verts);
+  std::cout << count << std::endl;
+  if (count < 3) count = 0; // fully outside
+
+  for (uint32_t i = 0; i < count; i++) verts[i].color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+  PolyGon p_out = put_polygon(idx, vertices, verts, count, work);
   p_out.translate = p.translate;
   p_out.scale = p.scale;
-  
-  for (uint32_t i = 0; i < p.idxs.size(); i++) {
-    verts.push_back(vertices[p.idxs[i]]);
+  return p_out;
+}
+
+// Greiner-Hormann clipping for concave subjects and windows. Both outlines
+// become rings of ClipNode, intersections are linked into both rings and
+// tagged entry/exit, and the result is traced by walking the rings and
+// jumping between them at every intersection. Nodes live in a ClipArena
+// reset once per frame, so after the first frames no node is allocated.
+// Like the original algorithm, a vertex lying exactly on the other outline
+// is not handled.
+typedef struct {
+  glm::vec2 p;
+  glm::vec4 color;
+  uint32_t next, prev;
+  uint32_t neighbor; // same intersection in the other ring
+  float alpha;       // position along the original edge
+  bool intersect, entry, visited;
+} ClipNode;
+
+typedef struct {
+  std::vector<ClipNode> nodes;
+  uint32_t used;
+} ClipArena;
+
+void clip_arena_reset(ClipArena *arena) {
+  arena->used = 0;
+}
+
+// returns an index, node pointers are invalidated when the arena grows
+uint32_t clip_node_push(ClipArena *arena, glm::vec2 p, glm::vec4 color) {
+  if (arena->used == arena->nodes.size()) arena->nodes.resize(arena->nodes.empty() ? 256 : arena->nodes.size() * 2);
+  uint32_t i = arena->used++;
+  arena->nodes[i] = (ClipNode){ .p = p, .color = color, .next = i, .prev = i, .neighbor = i, .alpha = 0.0f, .intersect = false, .entry = false, .visited = false };
+  return i;
+}
+
+void clip_node_link_after(ClipArena *arena, uint32_t at, uint32_t node) {
+  ClipNode *nodes = arena->nodes.data();
+  nodes[node].prev = at;
+  nodes[node].next = nodes[at].next;
+  nodes[nodes[at].next].prev = node;
+  nodes[at].next = node;
+}
+
+uint32_t clip_next_original(const ClipArena *arena, uint32_t i) {
+  do i = arena->nodes[i].next; while (arena->nodes[i].intersect);
+  return i;
+}
+
+// even-odd test against the original vertices of a ring
+bool point_in_ring(const ClipArena *arena, uint32_t first, glm::vec2 p) {
+  bool inside = false;
+  uint32_t a = first;
+  do {
+    uint32_t b = clip_next_original(arena, a);
+    glm::vec2 pa = arena->nodes[a].p, pb = arena->nodes[b].p;
+    if ((pa.y > p.y) != (pb.y > p.y) && p.x < pa.x + (p.y - pa.y) / (pb.y - pa.y) * (pb.x - pa.x)) inside = !inside;
+    a = b;
+  } while (a != first);
+  return inside;
+}
+
+// links the intersection at alpha into the ring after the original vertex at
+uint32_t clip_insert_intersection(ClipArena *arena, uint32_t at, glm::vec2 p, float alpha) {
+  uint32_t node = clip_node_push(arena, p, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+  arena->nodes[node].intersect = true;
+  arena->nodes[node].alpha = alpha;
+  while (arena->nodes[arena->nodes[at].next].intersect && arena->nodes[arena->nodes[at].next].alpha < alpha) at = arena->nodes[at].next;
+  clip_node_link_after(arena, at, node);
+  return node;
+}
+
+void clip_mark_entries(ClipArena *arena, uint32_t first, uint32_t other) {
+  bool entry = !point_in_ring(arena, other, arena->nodes[first].p);
+  uint32_t i = first;
+  do {
+    if (arena->nodes[i].intersect) {
+      arena->nodes[i].entry = entry;
+      entry = !entry;
+    }
+    i = arena->nodes[i].next;
+  } while (i != first);
+}
+
+void clip_emit(ClipBatch *out, const ClipNode *node) {
+  out->vertices.push_back((Vertex){ .position = glm::vec4(node->p, 0.0f, 1.0f), .color = node->color });
+}
+
+// appends subject AND window to out as one or more polygons, returns how many
+uint32_t greiner_hormann(ClipArena *arena, const Vertex *vertices, const uint32_t *subject, uint32_t ns, const glm::vec2 *window, uint32_t nw, ClipBatch *out) {
+  if (ns < 3 || nw < 3) return 0;
+  if (out->offsets.empty()) out->offsets.push_back(out->vertices.size());
+
+  const Vertex *v = &vertices[subject[0]];
+  uint32_t s_first = clip_node_push(arena, glm::vec2(v->position), v->color);
+  for (uint32_t i = ns - 1; i > 0; i--) {
+    v = &vertices[subject[i]];
+    clip_node_link_after(arena, s_first, clip_node_push(arena, glm::vec2(v->position), v->color));
+  }
+  uint32_t w_first = clip_node_push(arena, window[0], glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+  for (uint32_t i = nw - 1; i > 0; i--) {
+    clip_node_link_after(arena, w_first, clip_node_push(arena, window[i], glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)));
   }
 
-  verts = clip(verts.back(), verts, LEFT, e_min, e_max);
-  verts = clip(verts.back(), verts, RIGHT, e_min, e_max);
-  verts = clip(verts.back(), verts, BOTTOM, e_min, e_max);
-  verts = clip(verts.back(), verts, TOP, e_min, e_max);
+  uint32_t intersections = 0;
+  uint32_t s = s_first;
+  do {
+    uint32_t s_next = clip_next_original(arena, s);
+    uint32_t w = w_first;
+    do {
+      uint32_t w_next = clip_next_original(arena, w);
+      glm::vec2 p1 = arena->nodes[s].p, p2 = arena->nodes[s_next].p;
+      glm::vec2 q1 = arena->nodes[w].p, q2 = arena->nodes[w_next].p;
+      glm::vec2 r = p2 - p1, q = q2 - q1, d = q1 - p1;
+      float denom = r.x * q.y - r.y * q.x;
+      if (denom != 0.0f) {
+        float a = (d.x * q.y - d.y * q.x) / denom;
+        float b = (d.x * r.y - d.y * r.x) / denom;
+        if (a > 0.0f && a < 1.0f && b > 0.0f && b < 1.0f) {
+          glm::vec2 p = p1 + r * a;
+          uint32_t i1 = clip_insert_intersection(arena, s, p, a);
+          uint32_t i2 = clip_insert_intersection(arena, w, p, b);
+          arena->nodes[i1].neighbor = i2;
+          arena->nodes[i2].neighbor = i1;
+          intersections++;
+        }
+      }
+      w = w_next;
+    } while (w != w_first);
+    s = s_next;
+  } while (s != s_first);
+
+  if (intersections == 0) {
+    uint32_t first;
+    if (point_in_ring(arena, w_first, arena->nodes[s_first].p)) first = s_first;
+    else if (point_in_ring(arena, s_first, arena->nodes[w_first].p)) first = w_first;
+    else return 0;
+    uint32_t i = first;
+    do {
+      clip_emit(out, &arena->nodes[i]);
+      i = arena->nodes[i].next;
+    } while (i != first);
+    out->offsets.push_back(out->vertices.size());
+    return 1;
+  }
 
-  std::cout << verts.size() << std::endl;
-  Vertex v1 = verts[0];
+  clip_mark_entries(arena, s_first, w_first);
+  clip_mark_entries(arena, w_first, s_first);
 
-  v1.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-  
-  p_out.idxs.push_back(idx);
-  vertices[idx] = verts[0];
-  idx++;
-
-  p_out.idxs.push_back(idx);
-  verts[1].color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-  vertices[idx] = verts[1];
-  idx++;
-
-  p_out.idxs.push_back(idx);
-  verts[2].color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-  vertices[idx] = verts[2];
-  idx++;
-
-  Vertex last = verts[2];
-  for (uint32_t i = p_out.idxs.size()-1; i < verts.size(); ++i) {
-    p_out.idxs.push_back(idx);
-    vertices[idx] = v1;
-    idx++;
-    p_out.idxs.push_back(idx);
-    vertices[idx] = last;
-    idx++;
-    p_out.idxs.push_back(idx);
-    verts[i].color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-    vertices[idx] = verts[i];
-    idx++;
-    last = verts[i];
+  uint32_t polygons = 0;
+  for (uint32_t start = s_first;;) {
+    while (!arena->nodes[start].intersect || arena->nodes[start].visited) {
+      start = arena->nodes[start].next;
+      if (start == s_first) return polygons;
+    }
+
+    uint32_t cur = start;
+    clip_emit(out, &arena->nodes[cur]);
+    while (true) {
+      arena->nodes[cur].visited = true;
+      arena->nodes[arena->nodes[cur].neighbor].visited = true;
+      bool forward = arena->nodes[cur].entry;
+      do {
+        cur = forward ? arena->nodes[cur].next : arena->nodes[cur].prev;
+        clip_emit(out, &arena->nodes[cur]);
+      } while (!arena->nodes[cur].intersect);
+      cur = arena->nodes[cur].neighbor;
+      if (arena->nodes[cur].visited) break;
+    }
+    out->vertices.pop_back(); // back at start
+    out->offsets.push_back(out->vertices.size());
+    polygons++;
   }
-  
-  return p_out;
 }
 
+bool polygon_is_convex(const glm::vec2 *points, uint32_t n) {
+  bool positive = false, negative = false;
+  for (uint32_t i = 0; i < n; i++) {
+    glm::vec2 a = points[i], b = points[(i + 1) % n], c = points[(i + 2) % n];
+    float cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+    if (cross > 0.0f) positive = true;
+    if (cross < 0.0f) negative = true;
+  }
+  return !(positive && negative);
+}
+
+// clips a concave polygon, every piece becomes a polygon of its own in out
+void clip_concave(uint32_t *idx, Vertex *vertices, ClipArena *arena, ClipBatch *batch, std::vector<uint32_t> *work, PolyGon p, const glm::vec2 *window, uint32_t nw, std::vector<PolyGon> *out) {
+  batch->vertices.clear();
+  batch->offsets.clear();
+  uint32_t pieces = greiner_hormann(arena, vertices, p.outline.data(), p.outline.size(), window, nw, batch);
+
+  for (uint32_t k = 0; k < pieces; k++) {
+    PolyGon piece = put_polygon(idx, vertices, &batch->vertices[batch->offsets[k]], batch->offsets[k + 1] - batch->offsets[k], work);
+    piece.translate = p.translate;
+    piece.scale = p.scale;
+    out->push_back(piece);
+  }
+}
 
 void print_vertex(Vertex v) {
   std::cout << "vertex: " << glm::to_string(v.position) << std::endl;
@@ -270,8 +930,8 @@ void print_vertex(Vertex v) {
 
 void print_polygon(Vertex *vertices, uint32_t idx, PolyGon p) {
   std::cout << "polygon: " << std::endl;
-  for (uint32_t i = 0; i < p.idxs.size(); i++) {
-    print_vertex(vertices[p.idxs[i]]);
+  for (uint32_t i = 0; i < p.outline.size(); i++) {
+    print_vertex(vertices[p.outline[i]]);
   }
   std::cout << "finish polygon" << std::endl;
 }
@@ -281,8 +941,125 @@ glm::vec3 mouse_to_gl_point(float x, float y) {
   return glm::vec3((2.0f * x) / WIDTH - 1.0f, 1.0f - (2.0f * y) / HEIGHT, 0.0f);
 }
 
-void draw_triangles(uint32_t VAO, uint32_t program, std::vector<PolyGon> poly) {
-  for (const auto p : poly) {
+// Streaming vertex buffer. With ARB_buffer_storage it holds STREAM_FRAMES
+// copies of the vertex pool in one persistently mapped buffer: a frame
+// writes into the copy whose fence says the GPU is done with it and draws
+// from it with a base vertex. Without it there is one copy, written with
+// glBufferSubData. Every copy keeps the range marked dirty since it was
+// last written, so only changed vertices are copied.
+#define STREAM_FRAMES 3
+
+typedef struct {
+  uint32_t first, last; // vertices [first, last), empty when first >= last
+} DirtyRange;
+
+typedef struct {
+  uint32_t VBO;
+  uint32_t capacity; // vertices per copy
+  uint32_t stride;
+  uint32_t copies;
+  bool persistent;
+  uint8_t *mapped;
+  GLsync fences[STREAM_FRAMES];
+  DirtyRange dirty[STREAM_FRAMES];
+  uint32_t frame; // copy written and drawn this frame
+  uint64_t bytes_uploaded;
+} VertexStream;
+
+void stream_init(VertexStream *s, uint32_t capacity, uint32_t stride, bool persistent) {
+  s->capacity = capacity;
+  s->stride = stride;
+  s->persistent = persistent && GLEW_ARB_buffer_storage;
+  s->copies = s->persistent ? STREAM_FRAMES : 1;
+  s->mapped = nullptr;
+  s->frame = 0;
+  s->bytes_uploaded = 0;
+  for (uint32_t k = 0; k < STREAM_FRAMES; k++) {
+    s->fences[k] = 0;
+    s->dirty[k] = (DirtyRange){ .first = UINT32_MAX, .last = 0 };
+  }
+
+  GLsizeiptr size = (GLsizeiptr)s->copies * capacity * stride;
+  glGenBuffers(1, &s->VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+  if (s->persistent) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    s->mapped = (uint8_t *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+  }
+  if (s->persistent && s->mapped == nullptr) {
+    std::cerr << "Could not map the vertex stream, using glBufferSubData!" << std::endl;
+    glDeleteBuffers(1, &s->VBO);
+    glGenBuffers(1, &s->VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+    s->persistent = false;
+    s->copies = 1;
+    size = (GLsizeiptr)capacity * stride;
+  }
+  if (!s->persistent) glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+}
+
+// vertices [first, last) changed on the CPU
+void stream_mark(VertexStream *s, uint32_t first, uint32_t last) {
+  if (first >= last) return;
+  for (uint32_t k = 0; k < s->copies; k++) {
+    s->dirty[k].first = std::min(s->dirty[k].first, first);
+    s->dirty[k].last = std::max(s->dirty[k].last, last);
+  }
+}
+
+// brings the next copy up to date with vertices, returns the base vertex
+// to draw it with
+uint32_t stream_update(VertexStream *s, const void *vertices) {
+  if (s->persistent) {
+    s->frame = (s->frame + 1) % STREAM_FRAMES;
+    GLsync fence = s->fences[s->frame];
+    if (fence) {
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(fence);
+      s->fences[s->frame] = 0;
+    }
+  }
+  DirtyRange *d = &s->dirty[s->frame];
+  if (d->first < d->last) {
+    size_t offset = (size_t)d->first * s->stride;
+    size_t size = (size_t)(d->last - d->first) * s->stride;
+    if (s->persistent) {
+      memcpy(s->mapped + (size_t)s->frame * s->capacity * s->stride + offset, (const uint8_t *)vertices + offset, size);
+    } else {
+      glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+      glBufferSubData(GL_ARRAY_BUFFER, offset, size, (const uint8_t *)vertices + offset);
+    }
+    s->bytes_uploaded += size;
+    *d = (DirtyRange){ .first = UINT32_MAX, .last = 0 };
+  }
+  return s->frame * s->capacity;
+}
+
+// after the draws reading the copy of this frame
+void stream_fence(VertexStream *s) {
+  if (s->persistent) s->fences[s->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// uploads indices from the first one that differs from what the element
+// buffer already holds, returns the bytes uploaded
+size_t upload_indices(uint32_t EBO, const std::vector<uint32_t> &indices, std::vector<uint32_t> *uploaded) {
+  uint32_t first = 0;
+  while (first < indices.size() && first < uploaded->size() && indices[first] == (*uploaded)[first]) first++;
+  *uploaded = indices;
+  if (first == indices.size()) return 0;
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(uint32_t), (indices.size() - first) * sizeof(uint32_t), &indices[first]);
+  return (indices.size() - first) * sizeof(uint32_t);
+}
+
+// the idxs of every polygon are uploaded back to back into one element
+// buffer, in the same order as poly
+void draw_triangles(uint32_t VAO, uint32_t program, const std::vector<PolyGon> &poly, uint32_t base_vertex) {
+  uint32_t offset = 0;
+  for (const auto &p : poly) {
+    if (p.idxs.empty()) continue;
+    if (offset + p.idxs.size() > MAX_IDX_COUNT) break;
     int v_transform = glGetUniformLocation(program, "v_transform");
     glm::mat4 translate = glm::translate(glm::mat4(1.0f), p.translate);
     glm::mat4 scale = glm::scale(glm::mat4(1.0f), p.scale);
@@ -293,9 +1070,9 @@ void draw_triangles(uint32_t VAO, uint32_t program, std::vector<PolyGon> poly) {
     glUniform4f(v_bord_color, -1.0f, -1.0f, -1.0f, -1.0f);
     glBindVertexArray(VAO);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glDrawArrays(GL_TRIANGLES, p.idxs[0], p.idxs.size());
+    glDrawElementsBaseVertex(GL_TRIANGLES, p.idxs.size(), GL_UNSIGNED_INT, (void*)(offset * sizeof(uint32_t)), base_vertex);
+    offset += p.idxs.size();
   }
-  //glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
 }
 
 
@@ -348,19 +1125,28 @@ void loop(GLFWwindow *window) {
   Vertex vertices[MAX_VERTEX_COUNT];
   uint32_t idx = 0;
   std::vector<PolyGon> polys;
+  ClipScratch scratch;
+  ClipWindow clip_window;
+  ClipArena arena = {};
+  ClipBatch concave;
+  std::vector<uint32_t> work;
+  std::vector<glm::vec2> points;
+  std::vector<uint32_t> indices, uploaded_indices;
+  uint32_t uploaded_idx = 0; // the pool only grows, vertices past it are new
 
   glm::vec3 translate = glm::vec3(0.0f, 0.f, 0.f);
   //glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
 
-  uint32_t VAO, VBO;
+  uint32_t VAO, EBO;
+  VertexStream stream;
 
   glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
+  glGenBuffers(1, &EBO);
 
   glBindVertexArray(VAO);
   
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  stream_init(&stream, MAX_VERTEX_COUNT, sizeof(Vertex), true);
+  std::cout << "vertex stream: " << (stream.persistent ? "persistent mapped ring" : "glBufferSubData") << std::endl;
   
   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
   glEnableVertexAttribArray(0); // location 0
@@ -368,6 +1154,9 @@ void loop(GLFWwindow *window) {
   glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
   glEnableVertexAttribArray(1); // location 1
 
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, MAX_IDX_COUNT * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+
   glBindBuffer(GL_ARRAY_BUFFER, 0); 
 
   float start_time = glfwGetTime();
@@ -383,9 +1172,14 @@ void loop(GLFWwindow *window) {
 
   uint32_t mode = GL_FILL;
 
-  std::vector<Vertex> vs;
-  PolyGon f;
+  PolyGon f = (PolyGon){
+    .outline = {},
+    .idxs = {},
+    .translate = glm::vec3(0.0f),
+    .scale = glm::vec3(1.0f),
+  };
   while (!quit) {
+    clip_arena_reset(&arena);
     delta = glfwGetTime() - start_time;
     total_time += delta;
     if (delta < frame_time) {
@@ -418,21 +1212,29 @@ void loop(GLFWwindow *window) {
 	click_time = start_time;
       
 	print_polygon(vertices, idx, f);
-	PolyGon rect = polys[0];
-	Vertex min = vertices[rect.idxs[0]];
-	Vertex max = vertices[rect.idxs[2]];
-	glm::vec4 min_pos = (min.position * rect.scale.x) + glm::vec4(rect.translate.x, rect.translate.y, 0.0f, 0.0f);
-	glm::vec4 max_pos = (max.position * rect.scale.x) + glm::vec4(rect.translate.x, rect.translate.y, 0.0f, 0.0f);
-	PolyGon out = sutherland_hodgman(idx, vertices, f, glm::vec2(min_pos.x, min_pos.y), glm::vec2(max_pos.x, max_pos.y));
-	print_polygon(vertices, idx, out);
-	polys[polys.size() - 1] = out;
-	 
+	if (polys.size() > 1 && f.outline.size() >= 3) {
+	  PolyGon rect = polys[0];
+	  glm::vec2 window_points[4];
+	  polygon_points(vertices, rect.outline.data(), 4, rect.translate, rect.scale, window_points);
+
+	  points.resize(f.outline.size());
+	  polygon_points(vertices, f.outline.data(), f.outline.size(), glm::vec3(0.0f), glm::vec3(1.0f), points.data());
+
+	  polys.pop_back();
+	  if (polygon_is_convex(points.data(), points.size()) && clip_window_build(&clip_window, window_points, 4)) {
+	    polys.push_back(sutherland_hodgman(&idx, vertices, &scratch, &work, f, &clip_window));
+	  } else {
+	    clip_concave(&idx, vertices, &arena, &concave, &work, f, window_points, 4, &polys);
+	  }
+	  print_polygon(vertices, idx, polys.back());
+	}
+
 	f = (PolyGon){
+	  .outline = {},
 	  .idxs = {},
 	  .translate = glm::vec3(0.0f),
 	  .scale = glm::vec3(1.0f),
 	};
-	vs.clear();
       }
     }
 
@@ -463,70 +1265,40 @@ void loop(GLFWwindow *window) {
 	glm::vec4 color = glm::vec4(1.0 * (mouse_pos.x/1000.0f), 1.0 * (mouse_pos.y/1000.0f), 1.0 * (((mouse_pos.x + mouse_pos.y) / 2) / 1000.0f), 1.f); 
 		
 	if (idx == 1) {
-	  // primeiro triangulo
-	  std::vector<uint32_t> idxs;
-	  idxs.push_back(idx-1);
+	  // retangulo, 4 vertices in the pool and two triangles over them
 	  Vertex v1 = vertices[idx-1];
 	  print_vertex(v1);
-	  glm::vec4 xmin_ymax_pos = glm::vec4(v1.position.x, position.y, 0.0f, 1.0f);
-	  glm::vec4 xmax_ymin_pos = glm::vec4(position.x, v1.position.y, 0.0f, 1.0f);
-	  put_vertice(idx, vertices, xmax_ymin_pos, glm::vec4(1.0f, 0.0f, 0.0f, 0.1f));
-	  
-	  Vertex v2 = vertices[idx];
-	  print_vertex(v2);
-	  idxs.push_back(idx);
+	  put_vertice(idx, vertices, glm::vec4(position.x, v1.position.y, 0.0f, 1.0f), glm::vec4(1.0f, 0.0f, 0.0f, 0.1f));
 	  idx++;
 	  put_vertice(idx, vertices, position, glm::vec4(0.5f, 1.0f, 0.5f, 0.1f));
-	  Vertex v3 = vertices[idx];
-	  print_vertex(v3);
-	  idxs.push_back(idx);
-	  idx++;
-
-	  // segundo triangulo  
-
-	  vertices[idx] = v1;
-	  idxs.push_back(idx);
-	  idx++;
-	  vertices[idx] = v3;
-	  idxs.push_back(idx);
 	  idx++;
 	  put_vertice(idx, vertices, glm::vec4(v1.position.x, position.y, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 1.0f, 0.1f));
-	  idxs.push_back(idx);
 	  idx++;
 	  PolyGon poly = (PolyGon){
-	    .idxs = idxs,
+	    .outline = { 0, 1, 2, 3 },
+	    .idxs = {},
 	    .translate = translate,
 	    .scale = scale,
 	  };
+	  triangulate(vertices, poly.outline.data(), poly.outline.size(), &work, &poly.idxs);
 	  polys.push_back(poly);
 	} else {
 	  if (idx == 0) {
 	    put_vertice(idx, vertices, position, color);
 	    print_vertex(vertices[idx]);
 	    idx++;
-	  } else {
-	    if (vs.size() >= 3) {
-	      std::cout << "add next trangle" << std::endl; 
-	      Vertex v1 = vs[0];
-	      Vertex last = vertices[idx - 1];
-	      
-	      vertices[idx] = v1;
-	      f.idxs.push_back(idx);
-	      idx++;
-	      vertices[idx] = last;
-	      f.idxs.push_back(idx);
-	      idx++;
-	      put_vertice(idx, vertices, position, color);
-	      f.idxs.push_back(idx);
-	      idx++;
-
-	      polys[polys.size() - 1] = f;
-	    } else {
-	      std::cout << vs.size() << std::endl;
-	      vs.push_back((Vertex){ .position = position, .color = color});
-	      put_vertice(idx, vertices, position, color);
-	      print_vertex(vertices[idx]);
-	      idx++;
+	  } else if (idx < MAX_VERTEX_COUNT) {
+	    put_vertice(idx, vertices, position, color);
+	    print_vertex(vertices[idx]);
+	    f.outline.push_back(idx);
+	    idx++;
+	    // from the third vertex on f is drawn, retriangulated on every click
+	    if (f.outline.size() >= 3) {
+	      std::cout << "add vertex to polygon" << std::endl;
+	      f.idxs.clear();
+	      triangulate(vertices, f.outline.data(), f.outline.size(), &work, &f.idxs);
+	      if (f.outline.size() == 3) polys.push_back(f);
+	      else polys[polys.size() - 1] = f;
 	    }
 	  }
 	}
@@ -540,24 +1312,15 @@ void loop(GLFWwindow *window) {
       }
     }
 
-    if (vs.size() == 3 && polys.size() == 1) {
-      std::cout << "add triangle" << std::endl;
-      std::vector<uint32_t> iv;
-      for (uint32_t i = polys.back().idxs.size(); i < idx; ++i) {
-	iv.push_back(i);
-      }
-      std::cout << iv.size() << std::endl;
-      PolyGon poly = (PolyGon){
-	.idxs = iv,
-	.translate = glm::vec3(0.0f),
-	.scale = glm::vec3(1.0f),
-      };
-      f = poly;
-      polys.push_back(poly);
-    }
-    
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+    stream_mark(&stream, uploaded_idx, idx);
+    uploaded_idx = idx;
+    uint32_t base_vertex = stream_update(&stream, vertices);
+
+    indices.clear();
+    for (const auto &p : polys) indices.insert(indices.end(), p.idxs.begin(), p.idxs.end());
+    if (indices.size() > MAX_IDX_COUNT) indices.resize(MAX_IDX_COUNT);
+    glBindVertexArray(VAO);
+    upload_indices(EBO, indices, &uploaded_indices);
 	  
     if (polys.size() > 0) {
       polys[0].translate = translate;
@@ -568,7 +1331,8 @@ void loop(GLFWwindow *window) {
     glUseProgram(program);
 
     //glBindVertexArray(VAO);
-    draw_triangles(VAO, program, polys);
+    draw_triangles(VAO, program, polys, base_vertex);
+    stream_fence(&stream);
     
     //std::cout << "total clicks: " << total_click << std::endl;
     //std::cout << "total vertices: " << idx << std::endl;
@@ -580,9 +1344,584 @@ void loop(GLFWwindow *window) {
   glfwDestroyCursor(cursor);
 }
 
-int main(void) {
+void random_polygons(std::mt19937 *rng, uint32_t count, uint32_t sides, std::vector<Vertex> *vertices, std::vector<PolyGon> *polys) {
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(0.05f, 0.5f);
+  vertices->clear();
+  polys->resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    glm::vec2 c = glm::vec2(pos(*rng), pos(*rng));
+    float r = radius(*rng);
+    PolyGon *p = &(*polys)[i];
+    p->outline.clear();
+    p->translate = glm::vec3(0.0f);
+    p->scale = glm::vec3(1.0f);
+    for (uint32_t k = 0; k < sides; k++) {
+      float a = 6.2831853f * k / sides;
+      p->outline.push_back(vertices->size());
+      vertices->push_back((Vertex){ .position = glm::vec4(c.x + r * cosf(a), c.y + r * sinf(a), 0.0f, 1.0f), .color = glm::vec4(1.0f) });
+    }
+  }
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t count_mismatches(const ClipBatch *batch, const std::vector<std::vector<Vertex>> &reference) {
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < reference.size(); i++) {
+    uint32_t n = batch->offsets[i + 1] - batch->offsets[i];
+    if (n != reference[i].size()) {
+      mismatches++;
+      continue;
+    }
+    for (uint32_t k = 0; k < n; k++) {
+      if (batch->vertices[batch->offsets[i] + k].position != reference[i][k].position) {
+        mismatches++;
+        break;
+      }
+    }
+  }
+  return mismatches;
+}
+
+int bench_clip(uint32_t count) {
+  std::mt19937 rng(42);
+  std::vector<Vertex> vertices;
+  std::vector<PolyGon> polys;
+  random_polygons(&rng, count, 8, &vertices, &polys);
+  // every fourth polygon becomes an axis aligned box, its horizontal and
+  // vertical edges are what broke the old slope based intersec
+  for (uint32_t i = 0; i < count; i += 4) {
+    glm::vec4 right = vertices[polys[i].outline[0]].position, left = vertices[polys[i].outline[4]].position;
+    float r = (right.x - left.x) / 2.0f;
+    for (uint32_t k = 0; k < 8; k++) {
+      glm::vec4 *p = &vertices[polys[i].outline[k]].position;
+      p->x = (k / 2 == 0 || k / 2 == 3) ? right.x : left.x;
+      p->y = (k / 2 < 2) ? right.y + r : right.y - r;
+    }
+  }
+  glm::vec2 e_min = glm::vec2(-0.5f, -0.5f);
+  glm::vec2 e_max = glm::vec2(0.5f, 0.5f);
+  const uint32_t rounds = 10;
+
+  // the old path, four clip() calls allocating a vector each
+  std::vector<std::vector<Vertex>> reference(count);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      std::vector<Vertex> verts;
+      for (uint32_t k = 0; k < polys[i].outline.size(); k++) verts.push_back(vertices[polys[i].outline[k]]);
+      const Edge edges[4] = { LEFT, RIGHT, BOTTOM, TOP };
+      for (uint32_t e = 0; e < 4 && !verts.empty(); e++) verts = clip(verts.back(), verts, edges[e], e_min, e_max);
+      if (r == 0) reference[i] = verts;
+    }
+  }
+  double vector_ms = elapsed_ms(start);
+
+  ClipScratch scratch;
+  ClipBatch batch;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    clip_polygons(&scratch, vertices.data(), polys.data(), count, e_min, e_max, &batch);
+  }
+  double batch_ms = elapsed_ms(start);
+  uint32_t mismatches = count_mismatches(&batch, reference);
+
+  double total = (double)rounds * count;
+  std::cout << "vector clip: " << total / vector_ms / 1000.0 << " Mpolys/s" << std::endl;
+  std::cout << "batched clip: " << total / batch_ms / 1000.0 << " Mpolys/s, " << vector_ms / batch_ms << "x" << std::endl;
+
+  struct { const char *name; ClassifyFn fn; bool supported; } kernels[] = {
+    { "soa clip scalar", classify_scalar, true },
+#if defined(__x86_64__) || defined(__i386__)
+    { "soa clip sse", classify_sse, (bool)__builtin_cpu_supports("sse2") },
+    { "soa clip avx2", classify_avx2, (bool)__builtin_cpu_supports("avx2") },
+#endif
+  };
+  ClassifyFn selected = classify;
+  ClipSoA soa;
+  for (auto &k : kernels) {
+    if (!k.supported) continue;
+    classify = k.fn;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+      clip_polygons_soa(&soa, &scratch, vertices.data(), polys.data(), count, e_min, e_max, &batch);
+    }
+    double soa_ms = elapsed_ms(start);
+    mismatches += count_mismatches(&batch, reference);
+    std::cout << k.name << ": " << total / soa_ms / 1000.0 << " Mpolys/s, " << vector_ms / soa_ms << "x" << std::endl;
+  }
+  classify = selected;
+
+  uint32_t non_finite = 0;
+  for (uint32_t i = 0; i < batch.offsets[count]; i++) {
+    glm::vec4 p = batch.vertices[i].position;
+    if (!std::isfinite(p.x) || !std::isfinite(p.y)) non_finite++;
+  }
+  std::cout << "mismatches: " << mismatches << std::endl;
+  std::cout << "non finite vertices: " << non_finite << std::endl;
+  return mismatches == 0 && non_finite == 0 ? 0 : 1;
+}
+
+int bench_lines(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> pos(-2.0f, 2.0f);
+  std::vector<Vertex> vertices(2 * count);
+  std::vector<Line> lines(count);
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t k = 0; k < 2; k++) {
+      vertices[2 * i + k] = (Vertex){ .position = glm::vec4(pos(rng), pos(rng), 0.0f, 1.0f), .color = glm::vec4(1.0f) };
+      lines[i].idxs[k] = 2 * i + k;
+    }
+  }
+  // some axis aligned ones
+  for (uint32_t i = 0; i < count; i += 8) vertices[2 * i + 1].position.x = vertices[2 * i].position.x;
+  for (uint32_t i = 4; i < count; i += 8) vertices[2 * i + 1].position.y = vertices[2 * i].position.y;
+  glm::vec2 e_min = glm::vec2(-0.5f, -0.5f);
+  glm::vec2 e_max = glm::vec2(0.5f, 0.5f);
+  const uint32_t rounds = 10;
+
+  // one line at a time, same output as clip_lines
+  std::vector<Vertex> reference;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    reference.clear();
+    for (uint32_t i = 0; i < count; i++) {
+      Vertex v0 = vertices[lines[i].idxs[0]];
+      Vertex v1 = vertices[lines[i].idxs[1]];
+      glm::vec2 p0 = glm::vec2(v0.position);
+      glm::vec2 p1 = glm::vec2(v1.position);
+      if (!cohen_sutherland(&p0, &p1, e_min, e_max)) continue;
+      if (p0 != glm::vec2(v0.position)) v0 = (Vertex){ .position = glm::vec4(p0, 0.0f, 1.0f), .color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) };
+      if (p1 != glm::vec2(v1.position)) v1 = (Vertex){ .position = glm::vec4(p1, 0.0f, 1.0f), .color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) };
+      reference.push_back(v0);
+      reference.push_back(v1);
+    }
+  }
+  double cs_ms = elapsed_ms(start);
+
+  ClipSoA soa;
+  std::vector<Vertex> out;
+  uint32_t kept = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    kept = clip_lines(&soa, vertices.data(), lines.data(), count, e_min, e_max, &out);
+  }
+  double lb_ms = elapsed_ms(start);
+
+  uint32_t mismatches = 0;
+  if (out.size() != reference.size()) {
+    mismatches = count;
+  } else {
+    for (uint32_t i = 0; i < out.size(); i++) {
+      glm::vec2 d = glm::abs(glm::vec2(out[i].position) - glm::vec2(reference[i].position));
+      if (d.x > 1e-5f || d.y > 1e-5f || !std::isfinite(out[i].position.x) || !std::isfinite(out[i].position.y)) mismatches++;
+    }
+  }
+
+  double total = (double)rounds * count;
+  std::cout << "lines kept: " << kept << " of " << count << std::endl;
+  std::cout << "cohen-sutherland: " << total / cs_ms / 1000.0 << " Mlines/s" << std::endl;
+  std::cout << "batched liang-barsky: " << total / lb_ms / 1000.0 << " Mlines/s, " << cs_ms / lb_ms << "x" << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+int bench_window(uint32_t count) {
+  std::mt19937 rng(42);
+  std::vector<Vertex> vertices;
+  std::vector<PolyGon> polys;
+  random_polygons(&rng, count, 8, &vertices, &polys);
+  glm::vec2 e_min = glm::vec2(-0.5f, -0.5f);
+  glm::vec2 e_max = glm::vec2(0.5f, 0.5f);
+  const uint32_t rounds = 10;
+  ClipScratch scratch;
+  ClipWindow window;
+  uint32_t mismatches = 0;
+
+  // the axis aligned window given clockwise has to match clip_polygon and liang_barsky
+  glm::vec2 rect[4] = { e_min, glm::vec2(e_min.x, e_max.y), e_max, glm::vec2(e_max.x, e_min.y) };
+  if (!clip_window_build(&window, rect, 4)) mismatches++;
+  std::vector<Vertex> expected;
+  for (uint32_t i = 0; i < count; i++) {
+    Vertex *clipped;
+    uint32_t n = clip_polygon(&scratch, vertices.data(), polys[i].outline.data(), polys[i].outline.size(), e_min, e_max, &clipped);
+    expected.assign(clipped, clipped + n);
+    n = clip_polygon_window(&scratch, vertices.data(), polys[i].outline.data(), polys[i].outline.size(), &window, &clipped);
+    if (n != expected.size()) {
+      mismatches++;
+      continue;
+    }
+    for (uint32_t k = 0; k < n; k++) {
+      glm::vec4 d = glm::abs(clipped[k].position - expected[k].position);
+      if (d.x > 1e-5f || d.y > 1e-5f) {
+        mismatches++;
+        break;
+      }
+    }
+  }
+  for (uint32_t i = 0; i + 1 < vertices.size(); i += 2) {
+    glm::vec2 p0 = glm::vec2(vertices[i].position), p1 = glm::vec2(vertices[i + 1].position);
+    float a0 = 0.0f, a1 = 0.0f, b0 = 0.0f, b1 = 0.0f;
+    bool a = liang_barsky(p0, p1, e_min, e_max, &a0, &a1);
+    bool b = cyrus_beck(p0, p1, &window, &b0, &b1);
+    if (a != b || fabsf(a0 - b0) > 1e-5f || fabsf(a1 - b1) > 1e-5f) mismatches++;
+  }
+
+  // rotated octagon, the edge planes built once for the whole soup or per polygon
+  std::vector<glm::vec2> octagon(8);
+  for (uint32_t k = 0; k < 8; k++) {
+    float a = 0.3f + 6.2831853f * k / 8;
+    octagon[k] = glm::vec2(0.6f * cosf(a), 0.6f * sinf(a));
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      Vertex *clipped;
+      clip_window_build(&window, octagon.data(), octagon.size());
+      clip_polygon_window(&scratch, vertices.data(), polys[i].outline.data(), polys[i].outline.size(), &window, &clipped);
+    }
+  }
+  double rebuild_ms = elapsed_ms(start);
+
+  clip_window_build(&window, octagon.data(), octagon.size());
+  uint32_t outside = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) {
+      Vertex *clipped;
+      uint32_t n = clip_polygon_window(&scratch, vertices.data(), polys[i].outline.data(), polys[i].outline.size(), &window, &clipped);
+      if (r > 0) continue;
+      for (uint32_t k = 0; k < n; k++) {
+        for (uint32_t e = 0; e < window.normals.size(); e++) {
+          if (window_distance(&window, e, glm::vec2(clipped[k].position)) < -1e-5f) {
+            outside++;
+            break;
+          }
+        }
+      }
+    }
+  }
+  double once_ms = elapsed_ms(start);
+
+  double total = (double)rounds * count;
+  std::cout << "octagon window rebuilt per polygon: " << total / rebuild_ms / 1000.0 << " Mpolys/s" << std::endl;
+  std::cout << "octagon window built once: " << total / once_ms / 1000.0 << " Mpolys/s, " << rebuild_ms / once_ms << "x" << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  std::cout << "vertices outside window: " << outside << std::endl;
+  return mismatches == 0 && outside == 0 ? 0 : 1;
+}
+
+void random_star(std::mt19937 *rng, uint32_t points, glm::vec2 center, float radius, std::vector<Vertex> *out) {
+  std::uniform_real_distribution<float> jitter(0.8f, 1.2f);
+  out->resize(2 * points);
+  for (uint32_t k = 0; k < 2 * points; k++) {
+    float a = 3.14159265f * k / points;
+    float r = radius * jitter(*rng) * (k % 2 ? 0.4f : 1.0f);
+    (*out)[k] = (Vertex){ .position = glm::vec4(center.x + r * cosf(a), center.y + r * sinf(a), 0.0f, 1.0f), .color = glm::vec4(1.0f) };
+  }
+}
+
+float polygon_area(const Vertex *v, uint32_t n) {
+  float area = 0.0f;
+  for (uint32_t i = 0; i < n; i++) {
+    glm::vec4 a = v[i].position, b = v[(i + 1) % n].position;
+    area += a.x * b.y - b.x * a.y;
+  }
+  return area / 2.0f;
+}
+
+float batch_area(const ClipBatch *batch) {
+  float area = 0.0f;
+  for (uint32_t k = 0; k + 1 < batch->offsets.size(); k++) {
+    area += fabsf(polygon_area(&batch->vertices[batch->offsets[k]], batch->offsets[k + 1] - batch->offsets[k]));
+  }
+  return area;
+}
+
+int bench_concave(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 0.6f);
+  std::vector<std::vector<Vertex>> stars(count);
+  for (uint32_t i = 0; i < count; i++) random_star(&rng, 5 + i % 4, glm::vec2(pos(rng), pos(rng)), radius(rng), &stars[i]);
+  std::vector<uint32_t> star_idxs(16);
+  for (uint32_t k = 0; k < star_idxs.size(); k++) star_idxs[k] = k;
+
+  const uint32_t rounds = 10;
+  glm::vec2 rect[4] = { glm::vec2(-0.5f, -0.5f), glm::vec2(0.5f, -0.5f), glm::vec2(0.5f, 0.5f), glm::vec2(-0.5f, 0.5f) };
+  ClipWindow window;
+  clip_window_build(&window, rect, 4);
+  ClipScratch scratch;
+  ClipArena arena = {};
+  ClipBatch batch;
+  uint32_t mismatches = 0;
+
+  // against a convex window the Sutherland-Hodgman output may have zero width
+  // bridges between the pieces but still has the right area
+  std::vector<uint32_t> idxs;
+  for (uint32_t i = 0; i < count; i++) {
+    idxs.resize(stars[i].size());
+    for (uint32_t k = 0; k < idxs.size(); k++) idxs[k] = k;
+    Vertex *clipped;
+    uint32_t n = clip_polygon_window(&scratch, stars[i].data(), idxs.data(), idxs.size(), &window, &clipped);
+    clip_arena_reset(&arena);
+    batch.vertices.clear();
+    batch.offsets.clear();
+    greiner_hormann(&arena, stars[i].data(), idxs.data(), idxs.size(), rect, 4, &batch);
+    if (fabsf(fabsf(polygon_area(clipped, n)) - batch_area(&batch)) > 1e-4f) mismatches++;
+  }
+
+  // concave window, intersection has to be symmetric
+  std::vector<glm::vec2> window_points;
+  for (uint32_t i = 0; i + 1 < count; i += 2) {
+    window_points.resize(stars[i + 1].size());
+    for (uint32_t k = 0; k < window_points.size(); k++) window_points[k] = glm::vec2(stars[i + 1][k].position);
+    clip_arena_reset(&arena);
+    batch.vertices.clear();
+    batch.offsets.clear();
+    greiner_hormann(&arena, stars[i].data(), star_idxs.data(), stars[i].size(), window_points.data(), window_points.size(), &batch);
+    float ab = batch_area(&batch);
+
+    window_points.resize(stars[i].size());
+    for (uint32_t k = 0; k < window_points.size(); k++) window_points[k] = glm::vec2(stars[i][k].position);
+    clip_arena_reset(&arena);
+    batch.vertices.clear();
+    batch.offsets.clear();
+    greiner_hormann(&arena, stars[i + 1].data(), star_idxs.data(), stars[i + 1].size(), window_points.data(), window_points.size(), &batch);
+    if (fabsf(ab - batch_area(&batch)) > 1e-4f) mismatches++;
+  }
+
+  // one arena reset per round, like one per frame in loop
+  uint32_t warm_nodes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    clip_arena_reset(&arena);
+    batch.vertices.clear();
+    batch.offsets.clear();
+    for (uint32_t i = 0; i < count; i++) {
+      greiner_hormann(&arena, stars[i].data(), star_idxs.data(), stars[i].size(), rect, 4, &batch);
+    }
+    if (r == 0) warm_nodes = arena.nodes.size();
+  }
+  double gh_ms = elapsed_ms(start);
+
+  double total = (double)rounds * count;
+  std::cout << "greiner-hormann: " << total / gh_ms / 1000.0 << " Mpolys/s" << std::endl;
+  std::cout << "arena nodes: " << arena.nodes.size() << " (" << warm_nodes << " after the first round)" << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 && arena.nodes.size() == warm_nodes ? 0 : 1;
+}
+
+int bench_triangulate(uint32_t count) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> radius(0.1f, 0.6f);
+  std::vector<Vertex> vertices;
+  std::vector<PolyGon> polys;
+  // half convex, half concave stars
+  random_polygons(&rng, count / 2, 8, &vertices, &polys);
+  std::vector<Vertex> star;
+  for (uint32_t i = count / 2; i < count; i++) {
+    random_star(&rng, 5 + i % 4, glm::vec2(pos(rng), pos(rng)), radius(rng), &star);
+    PolyGon p = (PolyGon){ .outline = {}, .idxs = {}, .translate = glm::vec3(0.0f), .scale = glm::vec3(1.0f) };
+    for (const Vertex &v : star) {
+      p.outline.push_back(vertices.size());
+      vertices.push_back(v);
+    }
+    polys.push_back(p);
+  }
+
+  const uint32_t rounds = 10;
+  std::vector<uint32_t> work;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (auto &p : polys) {
+      p.idxs.clear();
+      triangulate(vertices.data(), p.outline.data(), p.outline.size(), &work, &p.idxs);
+    }
+  }
+  double ms = elapsed_ms(start);
+
+  // every polygon has n - 2 triangles, all turning like the polygon and
+  // adding up to its area
+  uint32_t bad = 0;
+  size_t fan_bytes = 0, indexed_bytes = 0;
+  std::vector<Vertex> outline;
+  for (const auto &p : polys) {
+    uint32_t n = p.outline.size();
+    outline.clear();
+    for (uint32_t i : p.outline) outline.push_back(vertices[i]);
+    float area = polygon_area(outline.data(), n);
+    float sum = 0.0f;
+    bool flipped = false;
+    for (uint32_t k = 0; k + 2 < p.idxs.size(); k += 3) {
+      float t = triangle_cross(glm::vec2(vertices[p.idxs[k]].position), glm::vec2(vertices[p.idxs[k + 1]].position), glm::vec2(vertices[p.idxs[k + 2]].position)) / 2.0f;
+      if (t * area < 0.0f) flipped = true;
+      sum += t;
+    }
+    if (p.idxs.size() != 3 * (n - 2) || flipped || fabsf(sum - area) > 1e-4f * fabsf(area)) bad++;
+    fan_bytes += p.idxs.size() * sizeof(Vertex);
+    indexed_bytes += n * sizeof(Vertex) + p.idxs.size() * sizeof(uint32_t);
+  }
+
+  std::cout << "triangulate: " << (double)rounds * count / ms / 1000.0 << " Mpolys/s" << std::endl;
+  std::cout << "duplicated vertices: " << fan_bytes << " bytes, indexed: " << indexed_bytes << " bytes, " << (double)fan_bytes / indexed_bytes << "x" << std::endl;
+  std::cout << "bad triangulations: " << bad << std::endl;
+  return bad == 0 ? 0 : 1;
+}
+
+// Draws frames polygons the way loop() does, one 8 vertex polygon added
+// every third frame, uploading the vertices with the old full glBufferData
+// when stream is null. With verify the copy drawn is read back every frame.
+double stream_frames(VertexStream *stream, uint32_t frames, uint32_t program, bool verify, uint32_t *mismatches, uint64_t *bytes, std::vector<uint8_t> *image) {
+  std::mt19937 rng(42);
+  std::vector<Vertex> vertices(MAX_VERTEX_COUNT), polygon;
+  std::vector<PolyGon> polys;
+  std::vector<uint32_t> work, indices, uploaded_indices;
+  uint32_t idx = 0, uploaded_idx = 0;
+
+  uint32_t VAO, VBO = 0, EBO;
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &EBO);
+  glBindVertexArray(VAO);
+  if (stream) {
+    glBindBuffer(GL_ARRAY_BUFFER, stream->VBO);
+  } else {
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+  }
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+  glEnableVertexAttribArray(1);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, MAX_IDX_COUNT * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+  glUseProgram(program);
+
+  *bytes = 0;
+  std::vector<Vertex> readback(MAX_VERTEX_COUNT);
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    if (frame % 3 == 0 && idx + 8 <= MAX_VERTEX_COUNT) {
+      random_star(&rng, 4, glm::vec2(0.0f), 0.2f + 0.7f * (frame % 97) / 97.0f, &polygon);
+      for (auto &v : polygon) v.color = glm::vec4((frame % 7) / 7.0f, (frame % 11) / 11.0f, 0.5f, 0.1f);
+      polys.push_back(put_polygon(&idx, vertices.data(), polygon.data(), polygon.size(), &work));
+    }
+
+    uint32_t base_vertex = 0;
+    if (stream) {
+      stream_mark(stream, uploaded_idx, idx);
+      uploaded_idx = idx;
+      base_vertex = stream_update(stream, vertices.data());
+    } else {
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_DYNAMIC_DRAW);
+      *bytes += vertices.size() * sizeof(Vertex);
+    }
+    indices.clear();
+    for (const auto &p : polys) indices.insert(indices.end(), p.idxs.begin(), p.idxs.end());
+    if (indices.size() > MAX_IDX_COUNT) indices.resize(MAX_IDX_COUNT);
+    glBindVertexArray(VAO);
+    *bytes += upload_indices(EBO, indices, &uploaded_indices);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    draw_triangles(VAO, program, polys, base_vertex);
+    if (stream) stream_fence(stream);
+
+    if (verify && stream) {
+      glBindBuffer(GL_ARRAY_BUFFER, stream->VBO);
+      glGetBufferSubData(GL_ARRAY_BUFFER, (GLintptr)base_vertex * sizeof(Vertex), idx * sizeof(Vertex), readback.data());
+      if (memcmp(readback.data(), vertices.data(), idx * sizeof(Vertex)) != 0) (*mismatches)++;
+    }
+  }
+  glFinish();
+  double ms = elapsed_ms(start);
+  if (stream) *bytes += stream->bytes_uploaded;
+
+  image->resize(WIDTH * HEIGHT * 4);
+  glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, image->data());
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &EBO);
+  if (VBO) glDeleteBuffers(1, &VBO);
+  return ms;
+}
+
+// needs a GL context, the same frames through every upload path must
+// leave the same pixels
+int bench_stream(uint32_t frames) {
+  uint32_t program;
+  if (compile_shaders(&program) != 0) return 1;
+
+  uint32_t FBO, RBO;
+  glGenFramebuffers(1, &FBO);
+  glGenRenderbuffers(1, &RBO);
+  glBindRenderbuffer(GL_RENDERBUFFER, RBO);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, RBO);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Could not create the offscreen framebuffer!" << std::endl;
+    return 1;
+  }
+  glViewport(0, 0, WIDTH, HEIGHT);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+  uint32_t mismatches = 0;
+  uint64_t bytes;
+  std::vector<uint8_t> reference, image;
+  double full_ms = stream_frames(nullptr, frames, program, false, &mismatches, &bytes, &reference);
+  std::cout << "glBufferData: " << bytes << " bytes uploaded, " << full_ms << " ms" << std::endl;
+
+  for (uint32_t persistent = 0; persistent < 2; persistent++) {
+    for (uint32_t verify = 0; verify < 2; verify++) {
+      VertexStream stream;
+      stream_init(&stream, MAX_VERTEX_COUNT, sizeof(Vertex), persistent);
+      if (persistent && !stream.persistent) {
+        std::cout << "no ARB_buffer_storage, skipping the persistent mapped ring" << std::endl;
+        glDeleteBuffers(1, &stream.VBO);
+        break;
+      }
+      double ms = stream_frames(&stream, frames, program, verify, &mismatches, &bytes, &image);
+      if (image != reference) mismatches++;
+      if (!verify) {
+        std::cout << (persistent ? "persistent mapped ring: " : "glBufferSubData: ") << bytes << " bytes uploaded, "
+                  << ms << " ms, " << full_ms / ms << "x" << std::endl;
+      }
+      if (stream.persistent) {
+        glBindBuffer(GL_ARRAY_BUFFER, stream.VBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        for (uint32_t k = 0; k < STREAM_FRAMES; k++) if (stream.fences[k]) glDeleteSync(stream.fences[k]);
+      }
+      glDeleteBuffers(1, &stream.VBO);
+    }
+  }
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
   std::cout << "hello, world!" << std::endl;
 
+  if (argc > 1 && strcmp(argv[1], "bench-clip") == 0) {
+    return bench_clip(argc > 2 ? atoi(argv[2]) : 10000);
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-lines") == 0) {
+    return bench_lines(argc > 2 ? atoi(argv[2]) : 100000);
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-window") == 0) {
+    return bench_window(argc > 2 ? atoi(argv[2]) : 10000);
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-concave") == 0) {
+    return bench_concave(argc > 2 ? atoi(argv[2]) : 10000);
+  }
+  if (argc > 1 && strcmp(argv[1], "bench-triangulate") == 0) {
+    return bench_triangulate(argc > 2 ? atoi(argv[2]) : 10000);
+  }
+
   if (!glfwInit()) {
     std::cerr << "Could not initialize glfw!" << std::endl;
     std::cerr << "error: " << strerror(errno) << std::endl;
@@ -597,6 +1936,9 @@ int main(void) {
   glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 
+  bool stream = argc > 1 && strcmp(argv[1], "bench-stream") == 0;
+  if (stream) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
   const char *title = "main.cpp - pizza";
 
   GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, title, nullptr, nullptr);
@@ -620,6 +1962,12 @@ int main(void) {
   std::cout << glGetString(GL_RENDERER) << std::endl;
   std::cout << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
   
+  if (stream) {
+    int result = bench_stream(argc > 2 ? atoi(argv[2]) : 600);
+    glfwTerminate();
+    return result;
+  }
+
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   
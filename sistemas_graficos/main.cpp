@@ -2,6 +2,10 @@
 #include <cstdint>
 #include <string.h>
 #include <errno.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -29,6 +33,18 @@ const static char *vertex_shader_source = "#version 330 core\n"
       "color = v_color\n;"
   "}\0";
 
+// the same triangle once, moved by a per instance matrix
+const static char *instanced_vertex_shader_source = "#version 330 core\n"
+  "layout (location = 0) in vec4 pos;\n"
+  "layout (location = 1) in vec4 v_color;\n"
+  "layout (location = 2) in mat4 i_translate;\n"
+  "out vec4 color;\n"
+  "void main()\n"
+  "{\n"
+  "   gl_Position = vec4(i_translate * pos);\n"
+  "   color = v_color;\n"
+  "}\0";
+
 // (color * v_color) * v_time
 const static char *fragment_shader_source = "#version 330 core\n"
   "in vec4 color;\n"
@@ -40,11 +56,11 @@ const static char *fragment_shader_source = "#version 330 core\n"
   "   FragColor = vec4((color * v_color) * v_time);\n"
   "}\n\0";
 
-int compile_shaders(uint32_t *shader_program) {
+int compile_program(const char *vertex_source, const char *fragment_source, uint32_t *shader_program) {
 
   // vertex shader
   unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
+  glShaderSource(vertex_shader, 1, &vertex_source, NULL);
   glCompileShader(vertex_shader);
   // check for shader compile errors
   int success;
@@ -58,7 +74,7 @@ int compile_shaders(uint32_t *shader_program) {
     }
   // fragment shader
   uint32_t fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
+  glShaderSource(fragment_shader, 1, &fragment_source, NULL);
   glCompileShader(fragment_shader);
   // check for shader compile errors
   glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
@@ -85,6 +101,10 @@ int compile_shaders(uint32_t *shader_program) {
   return 0;
 }
 
+int compile_shaders(uint32_t *shader_program) {
+  return compile_program(vertex_shader_source, fragment_shader_source, shader_program);
+}
+
 
 typedef struct {
   double x, y;
@@ -142,24 +162,114 @@ void resize_callback(GLFWwindow* window, int width, int height) {
   glViewport(0, 0, width, height);
 }
 
-#define MAX_TRIANGLES 1000
-#define MAX_VERTEX_COUNT MAX_TRIANGLES * 3
-#define MAX_IDX_COUNT MAX_TRIANGLES * 3
+// The vertex pool and the range written since it was last uploaded.
+// Writes go through put_vertice or store_write, store_flush uploads only
+// that range. The pool grows on the CPU like any vector; the VBO grows by
+// at least doubling, into a new buffer that the still valid vertices are
+// copied to with glCopyBufferSubData, so old draws keep the old one alive
+// and nothing goes back through the CPU.
+#define VERTEX_CHUNK 3072 // vertices, the VBO holds whole chunks
+
+typedef struct {
+  std::vector<Vertex> vertices;
+  uint32_t dirty_min, dirty_max; // [dirty_min, dirty_max), empty when min >= max
+  uint32_t VAO, VBO;
+  uint32_t capacity;     // vertices the VBO holds
+  uint32_t frame_bytes;  // uploaded by the last flush
+  uint64_t total_bytes;
+  uint32_t grows;
+} VertexStore;
+
+// for the VBO bound to GL_ARRAY_BUFFER
+void vertex_attributes() {
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+  glEnableVertexAttribArray(0);
+
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+  glEnableVertexAttribArray(1);
+}
+
+// creates the VBO and points the attributes of VAO at it
+void store_init(VertexStore *s, uint32_t VAO) {
+  s->vertices.clear();
+  s->dirty_min = UINT32_MAX;
+  s->dirty_max = 0;
+  s->VAO = VAO;
+  s->capacity = VERTEX_CHUNK;
+  s->frame_bytes = 0;
+  s->total_bytes = 0;
+  s->grows = 0;
+  glGenBuffers(1, &s->VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+  glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)s->capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+  glBindVertexArray(VAO);
+  vertex_attributes();
+}
+
+Vertex *store_write(VertexStore *s, uint32_t idx) {
+  if (idx >= s->vertices.size()) s->vertices.resize(idx + 1);
+  s->dirty_min = std::min(s->dirty_min, idx);
+  s->dirty_max = std::max(s->dirty_max, idx + 1);
+  return &s->vertices[idx];
+}
 
-uint32_t put_vertice(uint32_t idx, Vertex vertices[MAX_VERTEX_COUNT], Position pos, Color color) {
-  vertices[idx].position = pos;
-  vertices[idx].color = color;
+void store_grow(VertexStore *s, uint32_t count) {
+  uint32_t capacity = std::max(2 * s->capacity, (count + VERTEX_CHUNK - 1) / VERTEX_CHUNK * VERTEX_CHUNK);
+  uint32_t VBO;
+  glGenBuffers(1, &VBO);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+  glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, s->VBO);
+  // the dirty range is uploaded by the flush anyway
+  uint32_t end = std::min(s->dirty_min, s->capacity);
+  if (end > 0) glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)end * sizeof(Vertex));
+  if (s->dirty_max < s->capacity) {
+    GLintptr offset = (GLintptr)s->dirty_max * sizeof(Vertex);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, offset, (GLsizeiptr)s->capacity * sizeof(Vertex) - offset);
+  }
+  glDeleteBuffers(1, &s->VBO);
+  s->VBO = VBO;
+  s->capacity = capacity;
+  s->grows++;
+  glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+  glBindVertexArray(s->VAO);
+  vertex_attributes();
+}
+
+// once per frame, returns the bytes uploaded
+uint32_t store_flush(VertexStore *s) {
+  s->frame_bytes = 0;
+  if (s->dirty_min < s->dirty_max) {
+    if (s->vertices.size() > s->capacity) store_grow(s, s->vertices.size());
+    s->frame_bytes = (s->dirty_max - s->dirty_min) * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, s->VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)s->dirty_min * sizeof(Vertex), s->frame_bytes, &s->vertices[s->dirty_min]);
+    s->total_bytes += s->frame_bytes;
+    s->dirty_min = UINT32_MAX;
+    s->dirty_max = 0;
+  }
+  return s->frame_bytes;
+}
+
+uint32_t put_vertice(uint32_t idx, VertexStore *store, Position pos, Color color) {
+  Vertex *v = store_write(store, idx);
+  v->position = pos;
+  v->color = color;
   return idx;
 }
 
-Triangle put_triangle(uint32_t *idx, Vertex vertices[MAX_VERTEX_COUNT], Vec2 mouse_pos) {
-  uint32_t idx_v1 = put_vertice(*idx, vertices, (Position){ .x = -0.2, .y = -0.2, .z = 0.0f, .w = 1.0f }, (Color){ .r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f });
-  (*idx)++;
-  uint32_t idx_v2 = put_vertice(*idx, vertices, (Position){ .x = 0.2, .y = -0.2, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f });
-  (*idx)++;
-  uint32_t idx_v3 = put_vertice(*idx, vertices, (Position){ .x = 0.0f, .y = 0.2, .z = 0.0f, .w = 1.0f }, (Color){ .r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f });
-  (*idx)++;
+// every triangle has the same shape, only its translation differs
+const static Vertex triangle_mesh[3] = {
+  { .position = { .x = -0.2, .y = -0.2, .z = 0.0f, .w = 1.0f }, .color = { .r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f } },
+  { .position = { .x = 0.2, .y = -0.2, .z = 0.0f, .w = 1.0f }, .color = { .r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f } },
+  { .position = { .x = 0.0f, .y = 0.2, .z = 0.0f, .w = 1.0f }, .color = { .r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f } },
+};
 
+// takes the next three vertices of the pool, store_triangles writes them
+Triangle put_triangle(uint32_t *idx, Vec2 mouse_pos) {
+  uint32_t idx_v1 = (*idx)++;
+  uint32_t idx_v2 = (*idx)++;
+  uint32_t idx_v3 = (*idx)++;
 
   float x = (2.0f * (float)mouse_pos.x) / WIDTH - 1.0f;
   float y = 1.0f - (2.0f * (float)mouse_pos.y) / HEIGHT;
@@ -170,9 +280,19 @@ Triangle put_triangle(uint32_t *idx, Vertex vertices[MAX_VERTEX_COUNT], Vec2 mou
   };
 }
 
-void draw_triangles(uint32_t VAO, uint32_t program, Vertex *vertices, uint32_t tidx, Triangle triangles[MAX_TRIANGLES]) {
+// writes the mesh of the triangles added since the last call, only drawing
+// one call per triangle reads them. stored drops with the triangles popped
+void store_triangles(VertexStore *store, const std::vector<Triangle> &triangles, uint32_t *stored) {
+  *stored = std::min(*stored, (uint32_t)triangles.size());
+  for (uint32_t i = *stored; i < triangles.size(); i++) {
+    for (uint32_t k = 0; k < 3; k++) put_vertice(triangles[i].idxs[k], store, triangle_mesh[k].position, triangle_mesh[k].color);
+  }
+  *stored = triangles.size();
+}
+
+void draw_triangles(uint32_t VAO, uint32_t program, const std::vector<Triangle> &triangles) {
 
-  for (uint32_t i = 0; i < tidx; ++i) {
+  for (uint32_t i = 0; i < triangles.size(); ++i) {
     Triangle triangle = triangles[i];
     
     int v_translate = glGetUniformLocation(program, "v_translate");
@@ -183,6 +303,189 @@ void draw_triangles(uint32_t VAO, uint32_t program, Vertex *vertices, uint32_t t
   }
 }
 
+// Instanced triangles. The mesh is uploaded once, the instance buffer holds
+// just the translations, packed, and only the triangles added since the last
+// upload are copied. One glDrawArraysInstanced draws them all.
+typedef struct {
+  uint32_t VAO, mesh, VBO;
+  uint32_t capacity; // triangles the instance buffer holds
+  uint32_t uploaded; // triangles already in it
+  std::vector<glm::mat4> staging;
+} InstancedTriangles;
+
+void instanced_init(InstancedTriangles *t) {
+  glGenVertexArrays(1, &t->VAO);
+  glGenBuffers(1, &t->mesh);
+  glGenBuffers(1, &t->VBO);
+  t->capacity = 1024;
+  t->uploaded = 0;
+
+  glBindVertexArray(t->VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, t->mesh);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(triangle_mesh), triangle_mesh, GL_STATIC_DRAW);
+  vertex_attributes();
+
+  // a mat4 attribute takes four locations, one column each
+  glBindBuffer(GL_ARRAY_BUFFER, t->VBO);
+  glBufferData(GL_ARRAY_BUFFER, t->capacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+  for (uint32_t k = 0; k < 4; k++) {
+    glVertexAttribPointer(2 + k, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(k * sizeof(glm::vec4)));
+    glEnableVertexAttribArray(2 + k);
+    glVertexAttribDivisor(2 + k, 1);
+  }
+}
+
+// returns the bytes uploaded
+uint32_t instanced_upload(InstancedTriangles *t, const std::vector<Triangle> &triangles) {
+  uint32_t count = triangles.size();
+  t->uploaded = std::min(t->uploaded, count);
+  if (t->uploaded == count) return 0;
+  glBindBuffer(GL_ARRAY_BUFFER, t->VBO);
+  if (count > t->capacity) {
+    // orphan the old storage, the whole array goes up again
+    t->capacity = std::max(2 * t->capacity, count);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)t->capacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    t->uploaded = 0;
+  }
+  t->staging.clear();
+  for (uint32_t i = t->uploaded; i < count; i++) t->staging.push_back(triangles[i].translation);
+  uint32_t bytes = (count - t->uploaded) * sizeof(glm::mat4);
+  glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)t->uploaded * sizeof(glm::mat4), bytes, t->staging.data());
+  t->uploaded = count;
+  return bytes;
+}
+
+void draw_instanced(const InstancedTriangles &t, uint32_t count) {
+  if (count == 0) return;
+  glBindVertexArray(t.VAO);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 3, count);
+}
+
+// random clicks over the window
+void random_triangles(std::mt19937 *rng, uint32_t count, uint32_t *idx, std::vector<Triangle> *triangles) {
+  std::uniform_real_distribution<double> x(0.0, WIDTH), y(0.0, HEIGHT);
+  for (uint32_t i = 0; i < count; i++) triangles->push_back(put_triangle(idx, (Vec2){ .x = x(*rng), .y = y(*rng) }));
+}
+
+void set_color_uniforms(uint32_t program, Color color, float time) {
+  glUniform4f(glGetUniformLocation(program, "v_color"), color.r, color.g, color.b, color.a);
+  glUniform1f(glGetUniformLocation(program, "v_time"), time);
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// needs a GL context, adds count triangles flushing and rewriting along the
+// way so the VBO grows several times, then reads it back
+int bench_grow(uint32_t count) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> x(0.0, WIDTH), y(0.0, HEIGHT);
+  uint32_t VAO, idx = 0;
+  glGenVertexArrays(1, &VAO);
+  VertexStore store;
+  store_init(&store, VAO);
+  std::vector<Triangle> triangles;
+  uint32_t stored = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    triangles.push_back(put_triangle(&idx, (Vec2){ .x = x(rng), .y = y(rng) }));
+    store_triangles(&store, triangles, &stored);
+    // an old vertex changes, the dirty range spans the flushed ones
+    if (i % 1499 == 0) {
+      uint32_t old = rng() % idx;
+      put_vertice(old, &store, store.vertices[old].position, (Color){ .r = 1.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f });
+    }
+    // right click, the next triangle reuses the vertices
+    if (i % 5003 == 0) {
+      triangles.pop_back();
+      idx -= 3;
+    }
+    if (i % 997 == 0) store_flush(&store);
+  }
+  store_flush(&store);
+
+  std::vector<Vertex> gpu(store.vertices.size());
+  glBindBuffer(GL_ARRAY_BUFFER, store.VBO);
+  glGetBufferSubData(GL_ARRAY_BUFFER, 0, gpu.size() * sizeof(Vertex), gpu.data());
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < gpu.size(); i++) {
+    if (memcmp(&gpu[i], &store.vertices[i], sizeof(Vertex)) != 0) mismatches++;
+  }
+  // the VAO has to follow the VBO across grows
+  int binding = 0;
+  glBindVertexArray(VAO);
+  glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &binding);
+  if ((uint32_t)binding != store.VBO) mismatches++;
+
+  std::cout << "vertices: " << store.vertices.size() << ", VBO capacity: " << store.capacity << " (" << (store.capacity + VERTEX_CHUNK - 1) / VERTEX_CHUNK << " chunks), grows: " << store.grows << std::endl;
+  std::cout << "uploaded: " << store.total_bytes << " bytes" << std::endl;
+  std::cout << "mismatched vertices: " << mismatches << std::endl;
+  return mismatches == 0 && store.grows > 0 ? 0 : 1;
+}
+
+// needs a GL context, draws the same triangles one call each and instanced
+// into an offscreen framebuffer and compares the pixels
+int bench_instanced(uint32_t count) {
+  uint32_t program, instanced_program;
+  if (compile_shaders(&program) != 0) return 1;
+  if (compile_program(instanced_vertex_shader_source, fragment_shader_source, &instanced_program) != 0) return 1;
+
+  uint32_t FBO, RBO;
+  glGenFramebuffers(1, &FBO);
+  glGenRenderbuffers(1, &RBO);
+  glBindRenderbuffer(GL_RENDERBUFFER, RBO);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, RBO);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cerr << "Could not create the offscreen framebuffer!" << std::endl;
+    return 1;
+  }
+  glViewport(0, 0, WIDTH, HEIGHT);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+  std::mt19937 rng(42);
+  uint32_t VAO, idx = 0;
+  glGenVertexArrays(1, &VAO);
+  VertexStore store;
+  store_init(&store, VAO);
+  std::vector<Triangle> triangles;
+  uint32_t stored = 0;
+  random_triangles(&rng, count, &idx, &triangles);
+  store_triangles(&store, triangles, &stored);
+  store_flush(&store);
+  InstancedTriangles instanced;
+  instanced_init(&instanced);
+  uint32_t bytes = instanced_upload(&instanced, triangles);
+
+  Color color = (Color){ .r = 0.5f, .g = 0.7f, .b = 0.9f, .a = 1.0f };
+  std::vector<uint8_t> images[2];
+  double ms[2];
+  for (uint32_t k = 0; k < 2; k++) {
+    glUseProgram(k == 0 ? program : instanced_program);
+    set_color_uniforms(k == 0 ? program : instanced_program, color, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    if (k == 0) draw_triangles(VAO, program, triangles);
+    else draw_instanced(instanced, triangles.size());
+    glFinish();
+    ms[k] = elapsed_ms(start);
+    images[k].resize(WIDTH * HEIGHT * 4);
+    glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, images[k].data());
+  }
+
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < images[0].size(); i += 4) {
+    if (memcmp(&images[0][i], &images[1][i], 4) != 0) mismatches++;
+  }
+  std::cout << "triangles: " << count << ", instance buffer: " << bytes << " bytes" << std::endl;
+  std::cout << "one draw per triangle: " << count << " calls, " << ms[0] << " ms" << std::endl;
+  std::cout << "instanced: 1 call, " << ms[1] << " ms, " << ms[0] / ms[1] << "x" << std::endl;
+  std::cout << "mismatched pixels: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
+
 void loop(GLFWwindow *window) {
 
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -228,32 +531,32 @@ void loop(GLFWwindow *window) {
   uint32_t program;
   int error = compile_shaders(&program);
   if (error != 0) exit(1);
+  uint32_t instanced_program;
+  error = compile_program(instanced_vertex_shader_source, fragment_shader_source, &instanced_program);
+  if (error != 0) exit(1);
 
 
-  Triangle triangles[MAX_TRIANGLES];
-  uint32_t tidx = 0;
+  std::vector<Triangle> triangles;
 
   uint32_t idx = 0;
 
-  Vertex vertices[MAX_VERTEX_COUNT];
+  VertexStore store;
 
   Color color = (Color){ .r = 0.5f, .g = 0.5f, .b = 0.5f, .a = 1.0f };
   
-  uint32_t VAO, VBO;
+  uint32_t VAO;
 
   glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
 
-  glBindVertexArray(VAO);
-  
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-  glEnableVertexAttribArray(0);
+  store_init(&store, VAO);
 
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
-  glEnableVertexAttribArray(1);
+  InstancedTriangles instanced;
+  instanced_init(&instanced);
+  bool instancing = false;
+  uint32_t stored = 0; // triangles with their mesh in the store
+  std::mt19937 rng(42);
+  float click_time = 0.0f;
+  float threshold = 0.3f;
 
   glBindBuffer(GL_ARRAY_BUFFER, 0); 
 
@@ -279,23 +582,28 @@ void loop(GLFWwindow *window) {
       glClearColor(0.99, 0.3, 0.3, 1.0);
       selected = (ColorChannel)((selected + 1) % 4);
 
-      if (tidx < MAX_TRIANGLES) {
-	Triangle triangle = put_triangle(&idx, vertices, mouse_pos);
-	triangles[tidx++] = triangle;
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-      }
+      triangles.push_back(put_triangle(&idx, mouse_pos));
 
     } else if (is_mouse_button_pressed(window, GLFW_MOUSE_BUTTON_RIGHT)) {
       glClearColor(0.99, 0.3, 0.3, 1.0);
 
-      if (tidx > 0) {
-	tidx--;
-	idx -= 3;
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+      if (!triangles.empty()) {
+	triangles.pop_back();
+	idx -= 3; // the vertices stay in the VBO, nothing to upload
+	instanced.uploaded = std::min(instanced.uploaded, (uint32_t)triangles.size());
       }
       
+    } else if (is_key_pressed(window, GLFW_KEY_1)) {
+      if (glfwGetTime() - click_time > threshold) {
+	click_time = glfwGetTime();
+	instancing = !instancing;
+	std::cout << "draw: " << (instancing ? "instanced" : "one call per triangle") << std::endl;
+      }
+    } else if (is_key_pressed(window, GLFW_KEY_2)) {
+      if (glfwGetTime() - click_time > threshold) {
+	click_time = glfwGetTime();
+	random_triangles(&rng, 100000, &idx, &triangles);
+      }
     } else {
       // draw
       {
@@ -304,6 +612,10 @@ void loop(GLFWwindow *window) {
     }
     
     
+    // the per triangle mesh is written only when drawn from
+    if (!instancing) store_triangles(&store, triangles, &stored);
+    store_flush(&store);
+    uint32_t instance_bytes = instancing ? instanced_upload(&instanced, triangles) : 0;
     glClear(GL_COLOR_BUFFER_BIT);
   
     /* Clears color buffer to the RGBA defined values. */
@@ -346,12 +658,19 @@ void loop(GLFWwindow *window) {
     //glDrawArrays(GL_TRIANGLES, 0, 3);
     //glDrawElements(GL_TRIANGLES, idx, GL_UNSIGNED_INT, 0);
 
-    draw_triangles(VAO, program, vertices, tidx, triangles);
+    if (instancing) {
+      glUseProgram(instanced_program);
+      set_color_uniforms(instanced_program, color, cycle_time);
+      draw_instanced(instanced, triangles.size());
+    } else {
+      draw_triangles(VAO, program, triangles);
+    }
     
     std::cout << "selected channel: " << selected << std::endl;
     std::cout << "mouse x:" << mouse_pos.x << std::endl;
     std::cout << "mouse y:" << mouse_pos.y << std::endl;
-    std::cout << "total triangles: " << tidx << std::endl;
+    std::cout << "total triangles: " << triangles.size() << std::endl;
+    std::cout << "bytes uploaded: " << store.frame_bytes + instance_bytes << " (total " << store.total_bytes << ")" << std::endl;
     //std::cout << "cicle time: " << cycle_time << std::endl;
     
     glfwSwapBuffers(window);
@@ -359,7 +678,7 @@ void loop(GLFWwindow *window) {
   glfwDestroyCursor(cursor);
 }
 
-int main(void) {
+int main(int argc, char **argv) {
   std::cout << "hello, world!" << std::endl;
 
   if (!glfwInit()) {
@@ -376,6 +695,10 @@ int main(void) {
   glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
   glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 
+  bool bench = argc > 1 && strcmp(argv[1], "bench-instanced") == 0;
+  bool grow = argc > 1 && strcmp(argv[1], "bench-grow") == 0;
+  if (bench || grow) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
   const char *title = "main.cpp - pizza";
 
   GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, title, nullptr, nullptr);
@@ -399,6 +722,12 @@ int main(void) {
   std::cout << glGetString(GL_RENDERER) << std::endl;
   std::cout << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
   
+  if (bench || grow) {
+    int result = bench ? bench_instanced(argc > 2 ? atoi(argv[2]) : 100000) : bench_grow(argc > 2 ? atoi(argv[2]) : 300000);
+    glfwTerminate();
+    return result;
+  }
+
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   
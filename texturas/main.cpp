@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <chrono>
 #include <thread>
+#include <utility>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -22,6 +23,8 @@
 #define WIDTH 860
 #define HEIGHT 640
 
+#define CUBE_VERTEX_COUNT 36 // the cube is all the demo draws
+
 const static char *vertex_shader_source = R"(
   #version 330 core
   layout (location = 0) in vec4 v_pos;
@@ -162,7 +165,98 @@ glm::vec3 mouse_to_gl_point(float x, float y) {
   return glm::vec3((2.0f * x) / WIDTH - 1.0f, 1.0f - (2.0f * y) / HEIGHT, 0.0f);
 }
 
-void draw(uint32_t VAO, uint32_t program, uint32_t idx, Vertex *vertices, Cube cube) {
+// Frustum clip stage, same as camera/main.cpp where the guard band is
+// explained.
+
+#define GUARD_BAND 2.0f
+#define CLIP_PLANES 6
+#define CLIP_MAX_POLY 9 // a triangle clipped by 6 planes
+#define CLIP_MAX_VERTICES(count) ((count) * (CLIP_MAX_POLY - 2)) // fanned back into triangles
+
+enum ClipPlane { CLIP_LEFT, CLIP_RIGHT, CLIP_BOTTOM, CLIP_TOP, CLIP_NEAR, CLIP_FAR };
+
+Vertex lerp_vertex(Vertex a, Vertex b, float t) {
+  return Vertex{
+    .position = glm::mix(a.position, b.position, t),
+    .color = glm::mix(a.color, b.color, t),
+    .texcoord = glm::mix(a.texcoord, b.texcoord, t),
+  };
+}
+
+// signed distance to the plane, inside when >= 0
+float plane_distance(glm::vec4 p, ClipPlane plane) {
+  switch (plane) {
+  case CLIP_LEFT:   return p.x + GUARD_BAND * p.w;
+  case CLIP_RIGHT:  return GUARD_BAND * p.w - p.x;
+  case CLIP_BOTTOM: return p.y + GUARD_BAND * p.w;
+  case CLIP_TOP:    return GUARD_BAND * p.w - p.y;
+  case CLIP_NEAR:   return p.z + p.w;
+  case CLIP_FAR:    return p.w - p.z;
+  default:          return 0.0f;
+  }
+}
+
+// bit i set when p is outside plane i
+uint32_t outcode(glm::vec4 p) {
+  uint32_t code = 0;
+  for (uint32_t i = 0; i < CLIP_PLANES; i++) {
+    if (plane_distance(p, (ClipPlane)i) < 0.0f) code |= 1u << i;
+  }
+  return code;
+}
+
+uint32_t clip_edge(const Vertex *in, uint32_t n, Vertex *out, ClipPlane plane) {
+  uint32_t count = 0;
+  Vertex v1 = in[n - 1];
+  float d1 = plane_distance(v1.position, plane);
+  for (uint32_t i = 0; i < n; i++) {
+    Vertex v2 = in[i];
+    float d2 = plane_distance(v2.position, plane);
+    if ((d1 >= 0.0f) != (d2 >= 0.0f)) out[count++] = lerp_vertex(v1, v2, d1 / (d1 - d2));
+    if (d2 >= 0.0f) out[count++] = v2;
+    v1 = v2;
+    d1 = d2;
+  }
+  return count;
+}
+
+// transforms a triangle list by mvp, clips it and writes the surviving
+// triangles to out, which holds CLIP_MAX_VERTICES(count). returns how many
+// vertices were written
+uint32_t clip_triangles(const Vertex *in, uint32_t count, glm::mat4 mvp, Vertex *out) {
+  uint32_t n_out = 0;
+  for (uint32_t i = 0; i + 2 < count; i += 3) {
+    Vertex a[CLIP_MAX_POLY], b[CLIP_MAX_POLY];
+    uint32_t codes[3];
+    for (uint32_t k = 0; k < 3; k++) {
+      a[k] = in[i + k];
+      a[k].position = mvp * in[i + k].position;
+      codes[k] = outcode(a[k].position);
+    }
+    if (codes[0] & codes[1] & codes[2]) continue; // all outside the same plane
+
+    Vertex *poly = a;
+    uint32_t n = 3;
+    uint32_t crossed = codes[0] | codes[1] | codes[2];
+    if (crossed) {
+      Vertex *dst = b;
+      for (uint32_t p = 0; p < CLIP_PLANES && n > 0; p++) {
+        if (!(crossed & (1u << p))) continue;
+        n = clip_edge(poly, n, dst, (ClipPlane)p);
+        std::swap(poly, dst);
+      }
+    }
+
+    for (uint32_t k = 1; k + 1 < n; k++) {
+      out[n_out++] = poly[0];
+      out[n_out++] = poly[k];
+      out[n_out++] = poly[k + 1];
+    }
+  }
+  return n_out;
+}
+
+void draw(uint32_t VAO, uint32_t VBO, uint32_t program, uint32_t idx, Vertex *vertices, Vertex *clipped, Cube cube) {
   float time = (float)glfwGetTime();
   glm::mat4 view = glm::mat4(1.0f);
   view = glm::translate(view, glm::vec3(0.0f, 0.0f, -3.0f));
@@ -179,13 +273,19 @@ void draw(uint32_t VAO, uint32_t program, uint32_t idx, Vertex *vertices, Cube c
   int v_view = glGetUniformLocation(program, "v_view");
   int v_projection = glGetUniformLocation(program, "v_projection");
   int v_time = glGetUniformLocation(program, "v_time");
-  glUniformMatrix4fv(v_model, 1, GL_FALSE, &model[0][0]);
-  glUniformMatrix4fv(v_view, 1, GL_FALSE, &view[0][0]);
-  glUniformMatrix4fv(v_projection, 1, GL_FALSE, &projection[0][0]);
+  // vertices are uploaded already in clip space
+  uint32_t count = clip_triangles(vertices, idx, projection * view * model, clipped);
+  glm::mat4 identity = glm::mat4(1.0f);
+
+  glUniformMatrix4fv(v_model, 1, GL_FALSE, &identity[0][0]);
+  glUniformMatrix4fv(v_view, 1, GL_FALSE, &identity[0][0]);
+  glUniformMatrix4fv(v_projection, 1, GL_FALSE, &identity[0][0]);
   glUniform1f(v_time, time);
 
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(Vertex), clipped);
   glBindVertexArray(VAO);
-  glDrawArrays(GL_TRIANGLES, 0, idx);
+  glDrawArrays(GL_TRIANGLES, 0, count);
   //glDrawElements(GL_TRIANGLES, idx, GL_UNSIGNED_INT, 0);
 }
 
@@ -325,7 +425,8 @@ void loop(GLFWwindow *window) {
   // };
 
 
-  Vertex vertices[1000];
+  Vertex vertices[CUBE_VERTEX_COUNT];
+  Vertex clipped[CLIP_MAX_VERTICES(CUBE_VERTEX_COUNT)];
   uint32_t idx = 0;
 
   for (uint32_t i = 0; i < (sizeof(verts)/sizeof(verts[0]))-2; i += 5) {
@@ -352,7 +453,7 @@ void loop(GLFWwindow *window) {
   glBindVertexArray(VAO);
   
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(clipped), nullptr, GL_DYNAMIC_DRAW);
   
   glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
   glEnableVertexAttribArray(0); // location 0
@@ -490,7 +591,7 @@ void loop(GLFWwindow *window) {
     glBindTexture(GL_TEXTURE_2D, tex);
 
     //glBindVertexArray(VAO);
-    draw(VAO, program, idx, vertices, cube);
+    draw(VAO, VBO, program, idx, vertices, clipped, cube);
 
     
     // std::cout << "total clicks: " << total_click << std::endl;
@@ -4,6 +4,17 @@
 #include <errno.h>
 #include <chrono>
 #include <thread>
+#include <vector>
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -26,14 +37,18 @@
 #define MAX_VERTEX_COUNT MAX_TRIANGLES * 3
 #define MAX_IDX_COUNT MAX_TRIANGLES * 3
 
+// triangle i is vertices 3i..3i+2, its model matrix the texels 4i..4i+3
 const static char *vertex_shader_source = "#version 330 core\n"
   "layout (location = 0) in vec4 v_pos;\n"
   "layout (location = 1) in vec4 v_color;\n"
   "layout (location = 2) in float v_size;"
-  "uniform mat4 v_transform;"
+  "uniform samplerBuffer v_transforms;"
   "out vec4 color;\n"
   "void main()\n"
   "{\n"
+  "   int t = 4 * (gl_VertexID / 3);\n"
+  "   mat4 v_transform = mat4(texelFetch(v_transforms, t), texelFetch(v_transforms, t + 1),\n"
+  "                           texelFetch(v_transforms, t + 2), texelFetch(v_transforms, t + 3));\n"
   "   gl_Position = v_transform * v_pos;\n"
   "   gl_PointSize = v_size;\n"
   "   color = v_color\n;"
@@ -165,22 +180,182 @@ glm::vec3 mouse_to_gl_point(float x, float y) {
   return glm::vec3((2.0f * x) / WIDTH - 1.0f, 1.0f - (2.0f * y) / HEIGHT, 0.0f);
 }
 
-void draw_triangles(uint32_t VAO, uint32_t program, Vertex *vertices, uint32_t tidx, Triangle triangles[MAX_TRIANGLES]) {
-  for (uint32_t i = 0; i < tidx; ++i) {
-    Triangle triangle = triangles[i];
-    
-    int v_transform = glGetUniformLocation(program, "v_transform");
+typedef struct {
+  std::mutex lock;
+  std::deque<uint32_t> items;
+} WorkQueue;
+
+bool work_queue_pop(std::vector<WorkQueue> *queues, uint32_t id, uint32_t *item) {
+  {
+    WorkQueue *own = &(*queues)[id];
+    std::lock_guard<std::mutex> guard(own->lock);
+    if (!own->items.empty()) {
+      *item = own->items.back();
+      own->items.pop_back();
+      return true;
+    }
+  }
+  // own queue is empty, steal from the front of the others
+  for (uint32_t i = 1; i < queues->size(); i++) {
+    WorkQueue *victim = &(*queues)[(id + i) % queues->size()];
+    std::lock_guard<std::mutex> guard(victim->lock);
+    if (!victim->items.empty()) {
+      *item = victim->items.front();
+      victim->items.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
 
-    glm::mat4 translate = glm::translate(glm::mat4(1.0f), triangle.translate);
-    glm::mat4 scale = glm::scale(glm::mat4(1.0f), triangle.scale);
-    glm::mat4 rotate = glm::rotate(glm::mat4(1.0f), glm::radians(triangle.angle), triangle.axis);
-    glm::mat4 transform = translate * rotate * scale;
-    
-    glUniformMatrix4fv(v_transform, 1, GL_FALSE, &transform[0][0]);
+// runs fn(item) for item in [0, count) on a work-stealing pool
+void parallel_for(uint32_t count, uint32_t threads, const std::function<void(uint32_t)> &fn) {
+  if (threads == 0) threads = 1;
+  if (threads == 1 || count <= 1) {
+    for (uint32_t i = 0; i < count; i++) fn(i);
+    return;
+  }
+  std::vector<WorkQueue> queues(threads);
+  for (uint32_t i = 0; i < count; i++) {
+    queues[i * threads / count].items.push_back(i);
+  }
+
+  std::vector<std::thread> workers;
+  for (uint32_t id = 0; id < threads; id++) {
+    workers.emplace_back([&queues, &fn, id]() {
+      uint32_t item;
+      while (work_queue_pop(&queues, id, &item)) fn(item);
+    });
+  }
+  for (auto &w : workers) w.join();
+}
+
+// Model matrices of every triangle computed into one array, uploaded with
+// a single glBufferSubData into a texture buffer and drawn with a single
+// glDrawArrays. translate * rotate * scale only has the rotation columns
+// times the scale and the translation as the last column, so it is built
+// directly, the columns with SSE. Same operations in the same order as
+// the glm calls, so the matrices are the same.
+#define TRANSFORM_CHUNK 4096          // triangles per work item
+#define TRANSFORM_PARALLEL_MIN 16384  // below this one thread is faster
+
+glm::mat4 triangle_transform(const Triangle &triangle) {
+  glm::mat4 translate = glm::translate(glm::mat4(1.0f), triangle.translate);
+  glm::mat4 scale = glm::scale(glm::mat4(1.0f), triangle.scale);
+  glm::mat4 rotate = glm::rotate(glm::mat4(1.0f), glm::radians(triangle.angle), triangle.axis);
+  return translate * rotate * scale;
+}
+
+void transforms_range(const Triangle *triangles, uint32_t first, uint32_t last, glm::mat4 *out) {
+#if defined(__x86_64__) || defined(__i386__)
+  for (uint32_t i = first; i < last; i++) {
+    const Triangle &t = triangles[i];
+    float a = glm::radians(t.angle);
+    float c = cosf(a), s = sinf(a);
+    glm::vec3 axis = glm::normalize(t.axis);
+    glm::vec3 temp = axis * (1.0f - c);
+
+    __m128 v_axis = _mm_setr_ps(axis.x, axis.y, axis.z, 0.0f);
+    __m128 skew[3] = {
+      _mm_setr_ps(c, s * axis.z, -(s * axis.y), 0.0f),
+      _mm_setr_ps(-(s * axis.z), c, s * axis.x, 0.0f),
+      _mm_setr_ps(s * axis.y, -(s * axis.x), c, 0.0f),
+    };
+    float *m = &out[i][0][0];
+    for (int k = 0; k < 3; k++) {
+      __m128 column = _mm_add_ps(skew[k], _mm_mul_ps(_mm_set1_ps(temp[k]), v_axis));
+      _mm_storeu_ps(m + 4 * k, _mm_mul_ps(column, _mm_set1_ps(t.scale[k])));
+    }
+    _mm_storeu_ps(m + 12, _mm_setr_ps(t.translate.x, t.translate.y, t.translate.z, 1.0f));
+  }
+#else
+  for (uint32_t i = first; i < last; i++) out[i] = triangle_transform(triangles[i]);
+#endif
+}
+
+void compute_transforms(const Triangle *triangles, uint32_t count, glm::mat4 *out, uint32_t threads) {
+  if (count < TRANSFORM_PARALLEL_MIN) threads = 1;
+  uint32_t chunks = (count + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK;
+  parallel_for(chunks, threads, [&](uint32_t k) {
+    transforms_range(triangles, k * TRANSFORM_CHUNK, std::min(count, (k + 1) * TRANSFORM_CHUNK), out);
+  });
+}
+
+typedef struct {
+  uint32_t TBO, texture;
+  uint32_t capacity; // matrices
+} TransformBuffer;
+
+void transform_buffer_init(TransformBuffer *t) {
+  t->capacity = MAX_TRIANGLES;
+  glGenBuffers(1, &t->TBO);
+  glBindBuffer(GL_TEXTURE_BUFFER, t->TBO);
+  glBufferData(GL_TEXTURE_BUFFER, t->capacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+  glGenTextures(1, &t->texture);
+  glBindTexture(GL_TEXTURE_BUFFER, t->texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, t->TBO);
+}
+
+void transform_upload(TransformBuffer *t, const glm::mat4 *transforms, uint32_t count) {
+  glBindBuffer(GL_TEXTURE_BUFFER, t->TBO);
+  if (count > t->capacity) {
+    t->capacity = std::max(2 * t->capacity, count);
+    glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)t->capacity * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)count * sizeof(glm::mat4), transforms);
+}
+
+// triangles must be laid out in order, triangle i at vertex 3i
+void draw_triangles(uint32_t VAO, uint32_t program, const TransformBuffer &t, uint32_t tidx) {
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, t.texture);
+  glUniform1i(glGetUniformLocation(program, "v_transforms"), 0);
+  glBindVertexArray(VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3 * tidx);
+}
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, triangle.idxs[0], 3);
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int bench_transforms(uint32_t count, uint32_t threads) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f), angle(0.0f, 360.0f), size(0.1f, 2.0f);
+  std::vector<Triangle> triangles(count);
+  for (uint32_t i = 0; i < count; i++) {
+    triangles[i] = (Triangle){
+      .idxs = { 3 * i, 3 * i + 1, 3 * i + 2 },
+      .translate = glm::vec3(unit(rng), unit(rng), unit(rng)),
+      .scale = glm::vec3(size(rng), size(rng), size(rng)),
+      .angle = angle(rng),
+      .axis = glm::vec3(unit(rng), unit(rng), unit(rng) + 2.0f),
+    };
+  }
+  std::vector<glm::mat4> reference(count), transforms(count);
+  const uint32_t rounds = 10;
+
+  // the old draw_triangles, one glm composition per triangle
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint32_t i = 0; i < count; i++) reference[i] = triangle_transform(triangles[i]);
+  }
+  double glm_ms = elapsed_ms(start) / rounds;
+
+  uint32_t mismatches = 0;
+  uint32_t thread_counts[] = { 1, threads };
+  for (uint32_t n : thread_counts) {
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) compute_transforms(triangles.data(), count, transforms.data(), n);
+    double ms = elapsed_ms(start) / rounds;
+    for (uint32_t i = 0; i < count; i++) {
+      if (transforms[i] != reference[i]) mismatches++;
+    }
+    std::cout << n << " threads: " << count / ms / 1000.0 << " Mmatrices/s, " << glm_ms / ms << "x glm" << std::endl;
   }
+  std::cout << "glm per triangle: " << count / glm_ms / 1000.0 << " Mmatrices/s" << std::endl;
+  std::cout << "triangles: " << count << ", upload: " << count * sizeof(glm::mat4) << " bytes in one call" << std::endl;
+  std::cout << "mismatches: " << mismatches << std::endl;
+  return mismatches == 0 ? 0 : 1;
 }
 
 void loop(GLFWwindow *window) {
@@ -275,6 +450,11 @@ void loop(GLFWwindow *window) {
 
   tidx =+ 2;
 
+  std::vector<glm::mat4> transforms(MAX_TRIANGLES);
+  TransformBuffer transform_buffer;
+  transform_buffer_init(&transform_buffer);
+  uint32_t threads = std::thread::hardware_concurrency();
+
   uint32_t VAO, VBO;
 
   glGenVertexArrays(1, &VAO);
@@ -391,12 +571,15 @@ void loop(GLFWwindow *window) {
     triangles[0] = t1;
     triangles[1] = t2;
     
+    compute_transforms(triangles, tidx, transforms.data(), threads);
+    transform_upload(&transform_buffer, transforms.data(), tidx);
+
     glClear(GL_COLOR_BUFFER_BIT);
 
     glUseProgram(program);
 
     //glBindVertexArray(VAO);
-    draw_triangles(VAO, program, vertices, tidx, triangles);
+    draw_triangles(VAO, program, transform_buffer, tidx);
 
     
     // std::cout << "total clicks: " << total_click << std::endl;
@@ -409,9 +592,14 @@ void loop(GLFWwindow *window) {
   glfwDestroyCursor(cursor);
 }
 
-int main(void) {
+int main(int argc, char **argv) {
   std::cout << "hello, world!" << std::endl;
 
+  if (argc > 1 && strcmp(argv[1], "bench-transforms") == 0) {
+    uint32_t count = argc > 2 ? atoi(argv[2]) : 1000000;
+    return bench_transforms(count, argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency());
+  }
+
   if (!glfwInit()) {
     std::cerr << "Could not initialize glfw!" << std::endl;
     std::cerr << "error: " << strerror(errno) << std::endl;